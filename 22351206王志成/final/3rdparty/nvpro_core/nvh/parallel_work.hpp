@@ -20,12 +20,11 @@
 
 #pragma once
 
-#include <algorithm>
-#include <atomic>
 #include <cstdint>
 #include <functional>
-#include <thread>
-#include <vector>
+
+// the project's persistent work-stealing pool, see src/jobSystem.hpp
+#include "jobSystem.hpp"
 
 namespace nvh {
 // distributes batches of loops over BATCHSIZE items across
@@ -35,6 +34,7 @@ namespace nvh {
 //          callback does single item
 // ranges:  fn (uint64_t itemBegin, uint64_t itemEnd, uint32_t threadIndex)
 //          callback does loop `for (uint64_t itemIndex = itemBegin; itemIndex < itemEnd; itemIndex++)`
+// the loops run on JobSystem's workers plus the calling thread instead of spawning threads, threadIndex < numThreads
 
 template <uint64_t BATCHSIZE = 128>
 inline void parallel_batches(uint64_t numItems, std::function<void(uint64_t)> fn, uint32_t numThreads)
@@ -48,30 +48,7 @@ inline void parallel_batches(uint64_t numItems, std::function<void(uint64_t)> fn
   }
   else
   {
-    std::atomic_uint64_t counter = 0;
-
-    auto worker = [&]() {
-      uint64_t idx;
-      while((idx = counter.fetch_add(BATCHSIZE)) < numItems)
-      {
-        uint64_t last = std::min(numItems, idx + BATCHSIZE);
-        for(uint64_t i = idx; i < last; i++)
-        {
-          fn(i);
-        }
-      }
-    };
-
-    std::vector<std::thread> threads(numThreads);
-    for(uint32_t i = 0; i < numThreads; i++)
-    {
-      threads[i] = std::thread(worker);
-    }
-
-    for(uint32_t i = 0; i < numThreads; i++)
-    {
-      threads[i].join();
-    }
+    JobSystem::getInstance().parallelFor<BATCHSIZE>(numItems, fn, numThreads);
   }
 }
 
@@ -87,30 +64,7 @@ inline void parallel_batches(uint64_t numItems, std::function<void(uint64_t, uin
   }
   else
   {
-    std::atomic_uint64_t counter = 0;
-
-    auto worker = [&](uint32_t threadIdx) {
-      uint64_t idx;
-      while((idx = counter.fetch_add(BATCHSIZE)) < numItems)
-      {
-        uint64_t last = std::min(numItems, idx + BATCHSIZE);
-        for(uint64_t i = idx; i < last; i++)
-        {
-          fn(i, threadIdx);
-        }
-      }
-    };
-
-    std::vector<std::thread> threads(numThreads);
-    for(uint32_t i = 0; i < numThreads; i++)
-    {
-      threads[i] = std::thread(worker, i);
-    }
-
-    for(uint32_t i = 0; i < numThreads; i++)
-    {
-      threads[i].join();
-    }
+    JobSystem::getInstance().parallelFor<BATCHSIZE>(numItems, fn, numThreads);
   }
 }
 
@@ -123,27 +77,7 @@ inline void parallel_ranges(uint64_t numItems, std::function<void(uint64_t idxBe
   }
   else
   {
-    std::atomic_uint64_t counter = 0;
-
-    auto worker = [&](uint32_t threadIdx) {
-      uint64_t idx;
-      while((idx = counter.fetch_add(BATCHSIZE)) < numItems)
-      {
-        uint64_t last = std::min(numItems, idx + BATCHSIZE);
-        fn(idx, last, threadIdx);
-      }
-    };
-
-    std::vector<std::thread> threads(numThreads);
-    for(uint32_t i = 0; i < numThreads; i++)
-    {
-      threads[i] = std::thread(worker, i);
-    }
-
-    for(uint32_t i = 0; i < numThreads; i++)
-    {
-      threads[i].join();
-    }
+    JobSystem::getInstance().parallelRanges<BATCHSIZE>(numItems, fn, numThreads);
   }
 }
 }  // namespace nvh
@@ -0,0 +1,348 @@
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <string>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "jobSystem.hpp"
+#include "modelLoader.h"
+
+// runs the whole loader (cache disabled) on OBJ inputs and reports where the time goes
+//   loaderBenchmark [options] [model.obj ...]
+//     --synthetic <triangles>  also load a generated OBJ: a jittered quad grid split into 8 objects with
+//                              smoothing groups and one textured material per object
+//     --textures <dir>         texture directory of the given models (default: next to each model)
+//     --materials <dir>        material library search path (default: next to each model)
+//     --smooth                 generate smooth normals for corners without one
+//     --post                   also optimize meshes, build LODs and quantize, as the application does
+//     --compress               use the KTX2 texture cache: the first run encodes, the next ones only read
+//     --repeat <runs>          runs per input, phases are averaged (default 3)
+//     --json <file>            write the results as JSON, including the vertex cache statistics of every mesh
+// phases running per shape or per texture add up the time of all threads, so they can exceed the wall time
+
+struct sBenchmarkConfig
+{
+    std::vector<std::filesystem::path> inputs{};
+    size_t syntheticTriangles{0ULL};
+    std::filesystem::path texPath{};
+    std::filesystem::path materialPath{};
+    LoaderOptions options{};
+    uint32_t repeat{3U};
+    std::filesystem::path jsonPath{};
+};
+
+struct sBenchmarkResult
+{
+    std::string name{};
+    uint32_t runs{0U};
+    size_t meshes{0ULL};
+    size_t vertices{0ULL};
+    size_t triangles{0ULL};
+    size_t textures{0ULL};
+    double minWallSeconds{0.};
+    double meanWallSeconds{0.};
+    std::array<double, static_cast<size_t>(LoaderPhase::count)> meanPhaseSeconds{};
+    // vertex cache statistics before & after optimizing, the same for every run
+    double acmr[2]{};
+    double atvr[2]{};
+    struct sMeshCache
+    {
+        std::string name{};
+        size_t triangles{0ULL};
+        std::array<float, 2> acmr{};
+        std::array<float, 2> atvr{};
+    };
+    // per mesh, in mesh order
+    std::vector<sMeshCache> meshCache{};
+    size_t peakResidentBytes{0ULL};
+};
+
+// peak resident set size of the process so far
+static size_t getPeakResidentBytes()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters{};
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0ULL;
+    return counters.PeakWorkingSetSize;
+#else
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0ULL;
+#ifdef __APPLE__
+    return static_cast<size_t>(usage.ru_maxrss);
+#else
+    return static_cast<size_t>(usage.ru_maxrss) * 1024ULL;
+#endif
+#endif
+}
+
+// binary PPM, which stb_image decodes like any other format
+static void writeTexture(const std::filesystem::path &path, uint32_t size, uint32_t seed)
+{
+    auto file = fopen(path.generic_string().c_str(), "wb");
+    if (file == nullptr)
+        throw std::runtime_error("failed to write synthetic texture [" + path.generic_string() + "].");
+    fprintf(file, "P6\n%u %u\n255\n", size, size);
+    std::vector<uint8_t> row(static_cast<size_t>(size) * 3);
+    for (auto y = 0U; y < size; ++y)
+    {
+        for (auto x = 0U; x < size; ++x)
+        {
+            const auto checker = ((x / 32) + (y / 32) + seed) % 2 == 0;
+            row[3 * x + 0] = static_cast<uint8_t>(checker ? 255 : x);
+            row[3 * x + 1] = static_cast<uint8_t>(checker ? 255 : y);
+            row[3 * x + 2] = static_cast<uint8_t>(seed * 40);
+        }
+        fwrite(row.data(), 1, row.size(), file);
+    }
+    fclose(file);
+}
+
+// quads are written as such, so triangulation has work to do; positions and uvs are shared through indices,
+// corners are only split by smoothing groups and object boundaries
+static std::filesystem::path generateSyntheticModel(size_t triangleCount, const std::filesystem::path &directory)
+{
+    constexpr uint32_t objectCount = 8U;
+    constexpr uint32_t textureSize = 1024U;
+    std::filesystem::create_directories(directory);
+    const auto modelPath = directory / ("synthetic_" + std::to_string(triangleCount) + ".obj");
+    if (std::filesystem::exists(modelPath))
+        return modelPath;
+
+    auto material = fopen((directory / "synthetic.mtl").generic_string().c_str(), "w");
+    if (material == nullptr)
+        throw std::runtime_error("failed to write synthetic material library.");
+    for (auto o = 0U; o < objectCount; ++o)
+    {
+        fprintf(material, "newmtl material%u\nKa 0.1 0.1 0.1\nKd 0.8 0.8 0.8\nKs 0.2 0.2 0.2\nNs 32\nillum 2\nmap_Kd texture%u.ppm\n\n", o, o);
+        writeTexture(directory / ("texture" + std::to_string(o) + ".ppm"), textureSize, o);
+    }
+    fclose(material);
+
+    const auto gridSize = static_cast<uint32_t>(std::sqrt(triangleCount / 2.0)) + 1;
+    const auto rowsPerObject = (gridSize + objectCount - 1) / objectCount;
+    auto model = fopen(modelPath.generic_string().c_str(), "w");
+    if (model == nullptr)
+        throw std::runtime_error("failed to write synthetic model [" + modelPath.generic_string() + "].");
+    fprintf(model, "mtllib synthetic.mtl\n");
+
+    std::mt19937 random(42);
+    std::uniform_real_distribution<float> jitter(-.25f, .25f);
+    for (auto y = 0U; y <= gridSize; ++y)
+        for (auto x = 0U; x <= gridSize; ++x)
+            fprintf(model, "v %u %.4f %u\n", x, jitter(random), y);
+    for (auto y = 0U; y <= gridSize; ++y)
+        for (auto x = 0U; x <= gridSize; ++x)
+            fprintf(model, "vt %.5f %.5f\n", static_cast<float>(x) / 16.f, static_cast<float>(y) / 16.f);
+
+    auto vertexIndex = [&](uint32_t x, uint32_t y)
+    { return y * (gridSize + 1) + x + 1; };
+    for (auto o = 0U; o < objectCount; ++o)
+    {
+        fprintf(model, "o object%u\nusemtl material%u\n", o, o);
+        for (auto y = o * rowsPerObject; y < std::min(gridSize, (o + 1) * rowsPerObject); ++y)
+        {
+            // alternating smoothing groups per row band, with flat rows in between
+            fprintf(model, "s %u\n", y % 8 == 7 ? 0U : 1U + y / 8 % 2);
+            for (auto x = 0U; x < gridSize; ++x)
+            {
+                const uint32_t corners[4] = {vertexIndex(x, y), vertexIndex(x, y + 1), vertexIndex(x + 1, y + 1), vertexIndex(x + 1, y)};
+                fprintf(model, "f %u/%u %u/%u %u/%u %u/%u\n", corners[0], corners[0], corners[1], corners[1], corners[2], corners[2], corners[3], corners[3]);
+            }
+        }
+    }
+    fclose(model);
+    return modelPath;
+}
+
+static sBenchmarkResult runBenchmark(const std::filesystem::path &filePath, const sBenchmarkConfig &config)
+{
+    sBenchmarkResult result{};
+    result.name = filePath.generic_string();
+    result.minWallSeconds = std::numeric_limits<double>::max();
+    const auto texPath = config.texPath.empty() ? filePath.parent_path() : config.texPath;
+    const auto materialPath = config.materialPath.empty() ? filePath.parent_path() : config.materialPath;
+
+    for (auto run = 0U; run < config.repeat; ++run)
+    {
+        std::atomic_size_t meshes{0ULL}, vertices{0ULL}, triangles{0ULL}, textures{0ULL};
+        std::mutex meshCacheMutex;
+        std::vector<std::pair<uint32_t, sBenchmarkResult::sMeshCache>> meshCache{};
+        auto progress = std::make_shared<LoadingProgress>();
+        progress->onMeshLoaded = [&](uint32_t meshIndex, const Mesh &mesh)
+        {
+            ++meshes;
+            vertices += mesh.vertices.size();
+            triangles += mesh.faces.size();
+            std::lock_guard<std::mutex> lock(meshCacheMutex);
+            meshCache.emplace_back(meshIndex, sBenchmarkResult::sMeshCache{mesh.name, mesh.faces.size(), mesh.acmr, mesh.atvr});
+        };
+        progress->onTextureLoaded = [&](uint32_t, Texture &)
+        { ++textures; };
+
+        const auto begin = std::chrono::steady_clock::now();
+        ModelLoader::getInstance().loadAsync(progress, filePath, texPath, materialPath, config.options).get();
+        const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+        result.minWallSeconds = std::min(result.minWallSeconds, seconds);
+        result.meanWallSeconds += seconds / config.repeat;
+        for (auto phase = 0U; phase < static_cast<uint32_t>(LoaderPhase::count); ++phase)
+            result.meanPhaseSeconds[phase] += progress->timings().seconds(static_cast<LoaderPhase>(phase)) / config.repeat;
+        for (auto optimized = 0U; optimized < 2U; ++optimized)
+        {
+            result.acmr[optimized] = progress->timings().acmr(optimized);
+            result.atvr[optimized] = progress->timings().atvr(optimized);
+        }
+        std::sort(meshCache.begin(), meshCache.end(), [](const auto &a, const auto &b)
+                  { return a.first < b.first; });
+        result.meshCache.clear();
+        for (auto &entry : meshCache)
+            result.meshCache.emplace_back(std::move(entry.second));
+        result.meshes = meshes;
+        result.vertices = vertices;
+        result.triangles = triangles;
+        result.textures = textures;
+        ++result.runs;
+    }
+    result.peakResidentBytes = getPeakResidentBytes();
+    return result;
+}
+
+static void printResult(const sBenchmarkResult &result)
+{
+    printf("%s\n", result.name.c_str());
+    printf("  meshes: %zu, vertices: %zu, triangles: %zu, textures: %zu\n", result.meshes, result.vertices, result.triangles, result.textures);
+    printf("  wall: %8.3f s mean, %8.3f s min, %8.2f M vertices/s\n", result.meanWallSeconds, result.minWallSeconds, result.vertices / result.minWallSeconds * 1e-6);
+    for (auto phase = 0U; phase < static_cast<uint32_t>(LoaderPhase::count); ++phase)
+        printf("  %-16s %8.3f s\n", LoaderTimings::phaseNames[phase], result.meanPhaseSeconds[phase]);
+    printf("  ACMR: %.3f -> %.3f, ATVR: %.3f -> %.3f\n", result.acmr[0], result.acmr[1], result.atvr[0], result.atvr[1]);
+    printf("  peak RSS: %.1f MiB\n", result.peakResidentBytes / (1024. * 1024.));
+}
+
+static std::string escapeJson(const std::string &str)
+{
+    std::string res{};
+    for (const auto c : str)
+    {
+        if (c == '"' || c == '\\')
+            res += '\\';
+        res += c;
+    }
+    return res;
+}
+
+static bool writeJson(const std::filesystem::path &path, const std::vector<sBenchmarkResult> &results, const sBenchmarkConfig &config)
+{
+    auto file = fopen(path.generic_string().c_str(), "w");
+    if (file == nullptr)
+        return false;
+    fprintf(file, "{\n  \"threads\": %u,\n", JobSystem::getInstance().getConcurrency());
+    fprintf(file, "  \"options\": {\"smooth_normals\": %s, \"post_process\": %s, \"compress_textures\": %s, \"repeat\": %u},\n",
+            config.options.interpVertexNormal ? "true" : "false", config.options.optimizeMeshes ? "true" : "false",
+            config.options.compressTextures ? "true" : "false", config.repeat);
+    fprintf(file, "  \"results\": [\n");
+    for (auto i = 0ULL; i < results.size(); ++i)
+    {
+        const auto &result = results[i];
+        fprintf(file, "    {\n      \"input\": \"%s\",\n      \"runs\": %u,\n", escapeJson(result.name).c_str(), result.runs);
+        fprintf(file, "      \"meshes\": %zu,\n      \"vertices\": %zu,\n      \"triangles\": %zu,\n      \"textures\": %zu,\n",
+                result.meshes, result.vertices, result.triangles, result.textures);
+        fprintf(file, "      \"wall_seconds\": {\"mean\": %.6f, \"min\": %.6f},\n", result.meanWallSeconds, result.minWallSeconds);
+        fprintf(file, "      \"vertices_per_second\": %.1f,\n", result.vertices / result.minWallSeconds);
+        fprintf(file, "      \"phase_seconds\": {");
+        for (auto phase = 0U; phase < static_cast<uint32_t>(LoaderPhase::count); ++phase)
+            fprintf(file, "%s\"%s\": %.6f", phase ? ", " : "", LoaderTimings::phaseNames[phase], result.meanPhaseSeconds[phase]);
+        fprintf(file, "},\n      \"vertex_cache\": {\"acmr\": [%.4f, %.4f], \"atvr\": [%.4f, %.4f]}", result.acmr[0], result.acmr[1], result.atvr[0], result.atvr[1]);
+        fprintf(file, ",\n      \"mesh_vertex_cache\": [");
+        for (auto m = 0ULL; m < result.meshCache.size(); ++m)
+        {
+            const auto &mesh = result.meshCache[m];
+            fprintf(file, "%s\n        {\"name\": \"%s\", \"triangles\": %zu, \"acmr\": [%.4f, %.4f], \"atvr\": [%.4f, %.4f]}", m ? "," : "",
+                    escapeJson(mesh.name).c_str(), mesh.triangles, mesh.acmr[0], mesh.acmr[1], mesh.atvr[0], mesh.atvr[1]);
+        }
+        fprintf(file, "%s]", result.meshCache.empty() ? "" : "\n      ");
+        fprintf(file, ",\n      \"peak_rss_bytes\": %zu\n    }%s\n", result.peakResidentBytes, i + 1 < results.size() ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    return fclose(file) == 0;
+}
+
+int main(int argc, char **argv)
+{
+    sBenchmarkConfig config{};
+    config.options.interpVertexNormal = false;
+    config.options.enableCache = false;
+    for (auto i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const auto hasValue = i + 1 < argc;
+        if (arg == "--synthetic" && hasValue)
+            config.syntheticTriangles = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--textures" && hasValue)
+            config.texPath = argv[++i];
+        else if (arg == "--materials" && hasValue)
+            config.materialPath = argv[++i];
+        else if (arg == "--smooth")
+            config.options.interpVertexNormal = true;
+        else if (arg == "--post")
+            config.options.optimizeMeshes = config.options.buildLods = config.options.quantizeVertices = true;
+        else if (arg == "--compress")
+            config.options.compressTextures = true;
+        else if (arg == "--repeat" && hasValue)
+            config.repeat = std::max(1U, static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10)));
+        else if (arg == "--json" && hasValue)
+            config.jsonPath = argv[++i];
+        else if (arg.starts_with("--"))
+        {
+            printf("ERROR: unknown option %s.\n", arg.c_str());
+            return 1;
+        }
+        else
+            config.inputs.emplace_back(arg);
+    }
+    if (config.syntheticTriangles > 0)
+        config.inputs.emplace_back(generateSyntheticModel(config.syntheticTriangles, std::filesystem::temp_directory_path() / "loaderBenchmark"));
+    if (config.inputs.empty())
+    {
+        printf("usage: %s [--synthetic <triangles>] [--textures <dir>] [--materials <dir>] [--smooth] [--post] [--compress] [--repeat <runs>] [--json <file>] [model.obj ...]\n", argv[0]);
+        return 1;
+    }
+
+    printf("threads: %u, runs per input: %u\n", JobSystem::getInstance().getConcurrency(), config.repeat);
+    std::vector<sBenchmarkResult> results{};
+    for (const auto &input : config.inputs)
+    {
+        try
+        {
+            results.emplace_back(runBenchmark(input, config));
+            printResult(results.back());
+        }
+        catch (const std::exception &e)
+        {
+            printf("ERROR: failed to load [%s]: %s\n", input.generic_string().c_str(), e.what());
+            return 1;
+        }
+    }
+
+    if (!config.jsonPath.empty() && !writeJson(config.jsonPath, results, config))
+    {
+        printf("ERROR: failed to write [%s].\n", config.jsonPath.generic_string().c_str());
+        return 1;
+    }
+    return 0;
+}
\ No newline at end of file
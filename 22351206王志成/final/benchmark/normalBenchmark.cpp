@@ -0,0 +1,135 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <unordered_map>
+
+#include "normalGenerator.hpp"
+
+struct sGridMesh
+{
+    std::vector<float> positions{};
+    std::vector<uint32_t> indices{};
+    std::vector<uint32_t> smoothingGroups{};
+};
+
+// jittered height field, left half in smoothing group 1, right half in group 2, with a flat (group 0) strip in between
+static sGridMesh generateGrid(size_t faceCount)
+{
+    const auto gridSize = static_cast<uint32_t>(std::sqrt(faceCount / 2.0)) + 1;
+    sGridMesh mesh{};
+    mesh.positions.reserve(static_cast<size_t>(gridSize + 1) * (gridSize + 1) * 3);
+    mesh.indices.reserve(static_cast<size_t>(gridSize) * gridSize * 6);
+    mesh.smoothingGroups.reserve(static_cast<size_t>(gridSize) * gridSize * 2);
+
+    std::mt19937 random(42);
+    std::uniform_real_distribution<float> jitter(-.25f, .25f);
+    for (auto y = 0U; y <= gridSize; ++y)
+        for (auto x = 0U; x <= gridSize; ++x)
+            mesh.positions.insert(mesh.positions.end(), {static_cast<float>(x), jitter(random), static_cast<float>(y)});
+
+    for (auto y = 0U; y < gridSize; ++y)
+        for (auto x = 0U; x < gridSize; ++x)
+        {
+            const auto v0 = y * (gridSize + 1) + x;
+            const auto v1 = v0 + 1;
+            const auto v2 = v0 + gridSize + 2;
+            const auto v3 = v0 + gridSize + 1;
+            mesh.indices.insert(mesh.indices.end(), {v0, v2, v1, v0, v3, v2});
+            const auto group = x < gridSize / 2 - 2 ? 1U : (x < gridSize / 2 + 2 ? 0U : 2U);
+            mesh.smoothingGroups.insert(mesh.smoothingGroups.end(), {group, group});
+        }
+    return mesh;
+}
+
+// the loader's previous implementation, smoothing group -> vertex -> faces maps over welded vertices
+// (the upper bound is fixed to include the last group so both sides do the same work)
+static void referenceNormals(const sGridMesh &mesh, std::vector<nvmath::vec3f> &vertexNormals)
+{
+    const auto faceCount = mesh.indices.size() / 3;
+    auto getPosition = [&](uint32_t index)
+    { return nvmath::vec3f(mesh.positions[3 * index + 0], mesh.positions[3 * index + 1], mesh.positions[3 * index + 2]); };
+
+    std::vector<nvmath::vec3f> faceNormals(faceCount);
+    for (auto f = 0ULL; f < faceCount; ++f)
+    {
+        auto vec1 = nvmath::normalize(getPosition(mesh.indices[3 * f + 1]) - getPosition(mesh.indices[3 * f + 0]));
+        auto vec2 = nvmath::normalize(getPosition(mesh.indices[3 * f + 2]) - getPosition(mesh.indices[3 * f + 1]));
+        faceNormals[f] = nvmath::normalize(nvmath::cross(vec1, vec2));
+    }
+
+    std::unordered_map<uint32_t, std::unordered_map<uint32_t, std::vector<uint32_t>>> smoothGroupMap;
+    auto maxSmoothGroupIndex = 0U;
+    for (auto f = 0U; f < faceCount; ++f)
+    {
+        maxSmoothGroupIndex = std::max(maxSmoothGroupIndex, mesh.smoothingGroups[f]);
+        for (auto corner = 3 * f; corner < 3 * f + 3; ++corner)
+            smoothGroupMap[mesh.smoothingGroups[f]][mesh.indices[corner]].emplace_back(f);
+    }
+
+    vertexNormals.assign(mesh.positions.size() / 3, nvmath::vec3f_zero);
+    for (auto i = 0U; i <= maxSmoothGroupIndex; ++i)
+    {
+        if (!smoothGroupMap.contains(i))
+            continue;
+        for (const auto &[vertex, faces] : smoothGroupMap[i])
+        {
+            auto temp = nvmath::vec3f_zero;
+            for (const auto &faceIndex : faces)
+                temp += faceNormals[faceIndex];
+            vertexNormals[vertex] = nvmath::normalize(temp);
+        }
+    }
+}
+
+template <typename Func>
+static double measure(Func &&func)
+{
+    const auto begin = std::chrono::high_resolution_clock::now();
+    func();
+    const auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double>(end - begin).count();
+}
+
+int main(int argc, char **argv)
+{
+    const auto faceCount = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 4'000'000ULL;
+    const auto hardwareConcurrency = std::max(1U, std::thread::hardware_concurrency());
+    const auto mesh = generateGrid(faceCount);
+    const auto cornerCount = mesh.indices.size();
+    printf("faces: %zu, positions: %zu, threads: %u\n", cornerCount / 3, mesh.positions.size() / 3, hardwareConcurrency);
+
+    std::vector<nvmath::vec3f> referenceResult{};
+    const auto referenceTime = measure([&]()
+                                       { referenceNormals(mesh, referenceResult); });
+
+    auto getPositionIndex = [&](size_t corner)
+    { return mesh.indices[corner]; };
+    std::vector<nvmath::vec3f> serialResult{};
+    const auto serialTime = measure([&]()
+                                    { generateSmoothNormals(cornerCount, getPositionIndex, mesh.positions.data(), mesh.smoothingGroups.data(), serialResult, 1); });
+    std::vector<nvmath::vec3f> parallelResult{};
+    const auto parallelTime = measure([&]()
+                                      { generateSmoothNormals(cornerCount, getPositionIndex, mesh.positions.data(), mesh.smoothingGroups.data(), parallelResult, hardwareConcurrency); });
+
+    printf("unordered_map (previous): %8.3f s, %8.2f M faces/s\n", referenceTime, cornerCount / 3 / referenceTime * 1e-6);
+    printf("CSR, 1 thread:            %8.3f s, %8.2f M faces/s\n", serialTime, cornerCount / 3 / serialTime * 1e-6);
+    printf("CSR, %3u threads:         %8.3f s, %8.2f M faces/s\n", hardwareConcurrency, parallelTime, cornerCount / 3 / parallelTime * 1e-6);
+
+    // results must not depend on thread count, and stay close to the unweighted average of the previous code
+    auto maxDeviation = 0.f;
+    for (auto c = 0ULL; c < cornerCount; ++c)
+    {
+        if (serialResult[c] != parallelResult[c])
+        {
+            printf("ERROR: serial and parallel results differ at corner %zu.\n", static_cast<size_t>(c));
+            return 1;
+        }
+        if (mesh.smoothingGroups[c / 3] != 0)
+            maxDeviation = std::max(maxDeviation, std::acos(std::clamp(nvmath::dot(serialResult[c], referenceResult[mesh.indices[c]]), -1.f, 1.f)));
+    }
+    printf("max deviation from unweighted average: %.3f degrees\n", maxDeviation * 180.f / 3.14159265f);
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,94 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <unordered_map>
+
+#include "vertexWelder.hpp"
+
+// synthetic corner stream of a triangulated grid with UV seams every few cells,
+// which gives roughly the 6:1 corner/vertex ratio of real scanned or CAD meshes
+static std::vector<VertexAttribute> generateCorners(size_t cornerCount)
+{
+    const auto gridSize = static_cast<uint32_t>(std::sqrt(cornerCount / 6.0)) + 1;
+    std::vector<VertexAttribute> corners{};
+    corners.reserve(static_cast<size_t>(gridSize) * gridSize * 6);
+
+    std::mt19937 random(42);
+    std::uniform_real_distribution<float> jitter(-.25f, .25f);
+    std::vector<float> heights(static_cast<size_t>(gridSize + 1) * (gridSize + 1));
+    for (auto &height : heights)
+        height = jitter(random);
+
+    auto makeVertex = [&](uint32_t x, uint32_t y, uint32_t cellX, uint32_t cellY)
+    {
+        VertexAttribute vertex{};
+        vertex.position = {static_cast<float>(x), heights[y * (gridSize + 1) + x], static_cast<float>(y)};
+        vertex.normal = {0.f, 1.f, 0.f};
+        // every 4x4 block of cells gets its own uv island
+        vertex.uv = {static_cast<float>(x - cellX / 4 * 4) * .25f + static_cast<float>(cellX / 4),
+                     static_cast<float>(y - cellY / 4 * 4) * .25f + static_cast<float>(cellY / 4)};
+        return vertex;
+    };
+
+    for (auto y = 0U; y < gridSize && corners.size() < cornerCount; ++y)
+        for (auto x = 0U; x < gridSize && corners.size() < cornerCount; ++x)
+        {
+            corners.emplace_back(makeVertex(x, y, x, y));
+            corners.emplace_back(makeVertex(x + 1, y, x, y));
+            corners.emplace_back(makeVertex(x + 1, y + 1, x, y));
+            corners.emplace_back(makeVertex(x, y, x, y));
+            corners.emplace_back(makeVertex(x + 1, y + 1, x, y));
+            corners.emplace_back(makeVertex(x, y + 1, x, y));
+        }
+    return corners;
+}
+
+template <typename Func>
+static double measure(Func &&func)
+{
+    const auto begin = std::chrono::high_resolution_clock::now();
+    func();
+    const auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double>(end - begin).count();
+}
+
+int main(int argc, char **argv)
+{
+    const auto cornerCount = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 12'000'000ULL;
+    const auto corners = generateCorners(cornerCount);
+    printf("corners: %zu\n", corners.size());
+
+    std::vector<VertexAttribute> mapVertices{};
+    std::vector<uint32_t> mapIndices{};
+    const auto mapTime = measure([&]()
+                                 {
+                                     std::unordered_map<VertexAttribute, uint32_t> verticesMap;
+                                     mapIndices.reserve(corners.size());
+                                     for (const auto &corner : corners)
+                                     {
+                                         auto [iter, inserted] = verticesMap.try_emplace(corner, static_cast<uint32_t>(mapVertices.size()));
+                                         if (inserted)
+                                             mapVertices.emplace_back(corner);
+                                         mapIndices.emplace_back(iter->second);
+                                     } });
+
+    std::vector<VertexAttribute> weldVertices{};
+    std::vector<uint32_t> weldIndices{};
+    const auto weldTime = measure([&]()
+                                  {
+                                      VertexWelder welder{};
+                                      welder.weld(corners.data(), corners.size(), weldVertices, weldIndices); });
+
+    printf("unique vertices: %zu\n", weldVertices.size());
+    printf("std::unordered_map: %8.3f s, %8.2f M corners/s\n", mapTime, corners.size() / mapTime * 1e-6);
+    printf("VertexWelder:       %8.3f s, %8.2f M corners/s\n", weldTime, corners.size() / weldTime * 1e-6);
+
+    if (mapIndices != weldIndices || mapVertices.size() != weldVertices.size())
+    {
+        printf("ERROR: welded results differ.\n");
+        return 1;
+    }
+    return 0;
+}
\ No newline at end of file
@@ -45,6 +45,36 @@ vec3 calBarycentricCoords(in vec2 positionScreen, in vec2 triangleVerticesScreen
     return res / (area1 + area2 + area3);
 }
 
+// unlike calBarycentricCoords, keeps going linearly outside the triangle: used to evaluate it at neighbouring pixels
+vec3 calSignedBarycentricCoords(in vec2 positionScreen, in vec2 triangleVerticesScreen[3])
+{
+    const vec2 e1 = triangleVerticesScreen[1] - triangleVerticesScreen[0];
+    const vec2 e2 = triangleVerticesScreen[2] - triangleVerticesScreen[0];
+    const vec2 d = positionScreen - triangleVerticesScreen[0];
+    const float invDet = 1 / (e1.x * e2.y - e1.y * e2.x);
+    const float b1 = (d.x * e2.y - d.y * e2.x) * invDet;
+    const float b2 = (e1.x * d.y - e1.y * d.x) * invDet;
+    return vec3(1 - b1 - b2, b1, b2);
+}
+
+// tangent, bitangent & normal of a triangle from its positions and uvs, for normal maps with +y along +v
+mat3 calTangentFrame(in vec3 positions[3], in vec2 uvs[3], in vec3 normal)
+{
+    const vec3 e1 = positions[1] - positions[0];
+    const vec3 e2 = positions[2] - positions[0];
+    const vec2 d1 = uvs[1] - uvs[0];
+    const vec2 d2 = uvs[2] - uvs[0];
+    const float det = d1.x * d2.y - d1.y * d2.x;
+    // degenerate uvs leave the normal as is
+    if (abs(det) < 1e-12)
+        return mat3(vec3(0), vec3(0), normal);
+    vec3 tangent = (e1 * d2.y - e2 * d1.y) / det;
+    vec3 bitangent = (e2 * d1.x - e1 * d2.x) / det;
+    tangent = normalize(tangent - normal * dot(normal, tangent));
+    bitangent = normalize(bitangent - normal * dot(normal, bitangent));
+    return mat3(tangent, bitangent, normal);
+}
+
 vec4 convertScreenPositionToWorldPosition(in vec2 positionScreen, in vec3 barycentricCoords, in vec3 invW, in mat4 view, in mat4 proj)
 {
     float w = 1 / dot(invW, barycentricCoords);
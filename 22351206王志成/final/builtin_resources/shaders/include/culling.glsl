@@ -0,0 +1,67 @@
+#ifndef _CULLING_H_
+#define _CULLING_H_
+
+// screen space extent of a box: the uv rectangle (min in xy, max in zw) & the depth of its nearest point
+struct ProjectedBox
+{
+	vec4 uvRect;
+	float nearestDepth;
+	// beyond one plane of the view frustum with all its corners, depth is in [0, w]
+	bool outside;
+	// some corner is behind the near plane, the rectangle is then meaningless
+	bool crossesNear;
+};
+
+ProjectedBox projectBox(in mat4 matrixClip, in vec3 minPoint, in vec3 maxPoint)
+{
+	ProjectedBox box;
+	box.uvRect = vec4(1.0, 1.0, 0.0, 0.0);
+	box.nearestDepth = 1.0;
+	box.crossesNear = false;
+	uint outside = 63;
+	for (uint corner = 0; corner < 8; ++corner)
+	{
+		const vec3 pos = mix(minPoint, maxPoint, bvec3((corner & 1) != 0, (corner & 2) != 0, (corner & 4) != 0));
+		const vec4 clip = matrixClip * vec4(pos, 1.0);
+		uint planes = 0;
+		planes |= clip.x < -clip.w ? 1 : 0;
+		planes |= clip.x > clip.w ? 2 : 0;
+		planes |= clip.y < -clip.w ? 4 : 0;
+		planes |= clip.y > clip.w ? 8 : 0;
+		planes |= clip.z < 0.0 ? 16 : 0;
+		planes |= clip.z > clip.w ? 32 : 0;
+		outside &= planes;
+		if (clip.w <= 0.0 || clip.z < 0.0)
+		{
+			box.crossesNear = true;
+			continue;
+		}
+		const vec3 ndc = clip.xyz / clip.w;
+		box.uvRect.xy = min(box.uvRect.xy, ndc.xy * 0.5 + 0.5);
+		box.uvRect.zw = max(box.uvRect.zw, ndc.xy * 0.5 + 0.5);
+		box.nearestDepth = min(box.nearestDepth, ndc.z);
+	}
+	box.outside = outside != 0;
+	return box;
+}
+
+// the pyramid holds the farthest depth of every texel's footprint, the box is hidden when its nearest point is behind it
+// the level is chosen so the rectangle covers at most 2x2 texels
+bool occluded(in ProjectedBox box, in sampler2D depthPyramid)
+{
+	if (box.crossesNear)
+		return false;
+	const vec4 rect = clamp(box.uvRect, 0.0, 1.0);
+	const vec2 extent = (rect.zw - rect.xy) * vec2(textureSize(depthPyramid, 0));
+	const int level = clamp(int(ceil(log2(max(max(extent.x, extent.y), 1.0)))), 0, textureQueryLevels(depthPyramid) - 1);
+	const ivec2 levelSize = textureSize(depthPyramid, level);
+	const ivec2 first = clamp(ivec2(rect.xy * vec2(levelSize)), ivec2(0), levelSize - 1);
+	const ivec2 last = clamp(ivec2(rect.zw * vec2(levelSize)), first, min(first + 1, levelSize - 1));
+	float farthest = 0.0;
+	for (int y = first.y; y <= last.y; ++y)
+		for (int x = first.x; x <= last.x; ++x)
+			farthest = max(farthest, texelFetch(depthPyramid, ivec2(x, y), level).r);
+	return box.nearestDepth > farthest;
+}
+
+#endif
\ No newline at end of file
@@ -15,12 +15,67 @@ struct VertexAttribute
 	vec2 uv;
 };
 
+// QuantizedVertex is read as uvec4:
+// x = position.x | position.y << 16, y = position.z | boundsIndex << 16, z = octahedral normal (snorm16 x2), w = uv (half x2)
+struct VertexBounds
+{
+	vec4 minPoint;
+	vec4 scale;
+};
+
 struct FaceAttribute
 {
 	vec3 normal;
 	uint materialIndex;
 };
 
+struct InstanceAttribute
+{
+	mat4 transform;
+	mat4 normalTransform;
+	uint firstTriangle;
+	uint triangleCount;
+	uint meshIndex;
+	uint firstMeshletVisibility;
+};
+
+// triangles are relative to the mesh's first one
+struct Meshlet
+{
+	vec4 boundingSphere;
+	vec4 normalCone;
+	uint firstTriangle;
+	uint triangleCount;
+	uint vertexCount;
+	uint _;
+};
+
+// level 0 is the full resolution mesh, 5 levels at most
+struct MeshAttribute
+{
+	vec4 boundingMin;
+	vec4 boundingMax;
+	uint levelCount;
+	uint firstIndex[5];
+	uint indexCount[5];
+	float error[5];
+	uint firstMeshlet;
+	uint meshletCount;
+	uint _[2];
+};
+
+// VkDrawIndexedIndirectCommand, followed by the first triangle of the draw
+struct DrawCommand
+{
+	uint indexCount;
+	uint instanceCount;
+	uint firstIndex;
+	int vertexOffset;
+	uint firstInstance;
+	uint firstTriangle;
+	uint _[2];
+};
+
 struct MaterialAttribute
 {
 	vec3 ambient;
@@ -8,4 +8,28 @@ VertexAttribute unpackVertexData(in VertexInput i)
 	return VertexAttribute(i.slot0.xyz, i.slot1.xyz, i.slot2.xy);
 }
 
+vec3 decodeOctahedral(in vec2 e)
+{
+	vec3 n = vec3(e, 1 - abs(e.x) - abs(e.y));
+	const float t = max(-n.z, 0);
+	n.xy += mix(vec2(t), vec2(-t), greaterThanEqual(n.xy, vec2(0)));
+	return normalize(n);
+}
+
+uint unpackBoundsIndex(in uvec4 i)
+{
+	return i.y >> 16;
+}
+
+vec3 unpackQuantizedPosition(in uvec4 i, in VertexBounds bounds)
+{
+	const vec3 quantized = vec3(i.x & 0xFFFF, i.x >> 16, i.y & 0xFFFF);
+	return bounds.minPoint.xyz + quantized * bounds.scale.xyz;
+}
+
+VertexAttribute unpackQuantizedVertexData(in uvec4 i, in VertexBounds bounds)
+{
+	return VertexAttribute(unpackQuantizedPosition(i, bounds), decodeOctahedral(unpackSnorm2x16(i.z)), unpackHalf2x16(i.w));
+}
+
 #endif
\ No newline at end of file
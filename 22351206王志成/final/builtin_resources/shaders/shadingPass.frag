@@ -5,22 +5,28 @@
 
 #include "include/layout.glsl"
 
+// both views alias the vertex buffer, vertexFormat tells which one is valid
 layout(set = 0, binding = 0) restrict readonly buffer VertexAttributes { VertexInput vertices[]; };
+layout(set = 0, binding = 0) restrict readonly buffer QuantizedVertexAttributes { uvec4 quantizedVertices[]; };
 layout(set = 0, binding = 1) restrict readonly buffer FaceAttributes { FaceAttribute faces[]; };
 layout(set = 0, binding = 2) restrict readonly buffer MaterialAttributes { MaterialAttribute materials[]; };
 layout(set = 0, binding = 3) restrict readonly buffer IndexAttributes { uint indices[]; };
-layout(set = 1, binding = 0) uniform sampler2D visibilityBuffer;
+layout(set = 0, binding = 4) restrict readonly buffer VertexBoundsAttributes { VertexBounds bounds[]; };
+layout(set = 0, binding = 5) restrict readonly buffer InstanceAttributes { InstanceAttribute instances[]; };
+layout(set = 1, binding = 0) uniform usampler2D visibilityBuffer;
 layout(set = 1, binding = 1) uniform sampler2D depthBuffer;
-layout(set = 2, binding = 0) uniform sampler2D textures[];
+// per texture: 0 when not sampled, otherwise 1 + log2 of the most texels per uv unit a pixel needed; read back for the streaming
+layout(set = 2, binding = 0) restrict coherent buffer TextureFeedback { uint textureFeedback[]; };
+layout(set = 2, binding = 1) uniform sampler2D textures[];
 
 layout(push_constant) uniform PushConstants 
 {
-    mat4 matrixModel;
     mat4 matrixView;
 	mat4 matrixProj;
 	float nearClip;
 	float farClip;
-	vec2 _;
+	uint vertexFormat;
+	float _;
 	vec3 lightDirection;
 	float lightIntensity;
 };
@@ -31,29 +37,67 @@ layout(location = 0) out vec4 fragColor;
 #include "include/packing.glsl"
 #include "include/common.glsl"
 
+VertexAttribute fetchVertex(in uint index)
+{
+	if (vertexFormat == 1)
+	{
+		const uvec4 vertex = quantizedVertices[index];
+		return unpackQuantizedVertexData(vertex, bounds[unpackBoundsIndex(vertex)]);
+	}
+	return unpackVertexData(vertices[index]);
+}
+
+// the whole frame would mostly hit the same few counters, one pixel of each 4x4 block is enough to find the visible textures
+bool isFeedbackPixel()
+{
+	return all(equal(ivec2(gl_FragCoord.xy) & 3, ivec2(0)));
+}
+
+void requestTexture(in uint index, in vec2 uvDx, in vec2 uvDy)
+{
+	const float footprint = max(max(length(uvDx), length(uvDy)), 1e-9);
+	atomicMax(textureFeedback[index], uint(clamp(ceil(-log2(footprint)), 0, 30)) + 1);
+}
+
 void main()
 {
-	const uint unpackedIndices = packUnorm4x8(texture(visibilityBuffer, texCoords));
-	if(unpackedIndices == 0U) discard;
-	const bool isAlpha = bool(unpackedIndices & 0x80000000);
-	const uint instanceIndex = (unpackedIndices >> 23) & 255;
-	const uint primitiveIndex = unpackedIndices & ((1 << 23) - 1);
+	const uvec2 visibility = texelFetch(visibilityBuffer, ivec2(gl_FragCoord.xy), 0).xy;
+	if(visibility.x == 0U) discard;
+	const uint instanceIndex = visibility.x - 1;
+	const uint primitiveIndex = visibility.y;
+	const InstanceAttribute instance = instances[instanceIndex];
 
 	TriangleData data;
-	data.vertices[0] = unpackVertexData(vertices[indices[3 * primitiveIndex + 0]]);
-	data.vertices[1] = unpackVertexData(vertices[indices[3 * primitiveIndex + 1]]);
-	data.vertices[2] = unpackVertexData(vertices[indices[3 * primitiveIndex + 2]]);
+	data.vertices[0] = fetchVertex(indices[3 * primitiveIndex + 0]);
+	data.vertices[1] = fetchVertex(indices[3 * primitiveIndex + 1]);
+	data.vertices[2] = fetchVertex(indices[3 * primitiveIndex + 2]);
 	data.material = materials[faces[primitiveIndex].materialIndex];
 	data.faceNormal = faces[primitiveIndex].normal;
 
-	RasterizedTriangle rasterData = rasterization(data, matrixModel, matrixView, matrixProj);
+	RasterizedTriangle rasterData = rasterization(data, instance.transform, matrixView, matrixProj);
 	vec3 barycentricCoords = calBarycentricCoords(texCoords, rasterData.positionScreen);
 	vec4 positionWorld = convertScreenPositionToWorldPosition(texCoords, barycentricCoords, rasterData.invW, matrixView, matrixProj);
 	vec4 positionCamera = calCameraPosition(matrixView);
 
-	vec2 uv = perspectiveCorrectBarycentricInterpolation(vec2[3](data.vertices[0].uv, data.vertices[1].uv, data.vertices[2].uv), barycentricCoords, rasterData.invW);
+	const vec2 uvs[3] = vec2[3](data.vertices[0].uv, data.vertices[1].uv, data.vertices[2].uv);
+	vec2 uv = perspectiveCorrectBarycentricInterpolation(uvs, barycentricCoords, rasterData.invW);
+	// this pass is a full screen triangle, implicit derivatives would mix neighbouring triangles' uvs:
+	// the mip is selected from this triangle's uvs at the next pixel in x and y instead
+	const vec2 pixelSize = 1.f / vec2(textureSize(visibilityBuffer, 0));
+	const vec2 uvDx = perspectiveCorrectBarycentricInterpolation(uvs, calSignedBarycentricCoords(texCoords + vec2(pixelSize.x, 0), rasterData.positionScreen), rasterData.invW) - uv;
+	const vec2 uvDy = perspectiveCorrectBarycentricInterpolation(uvs, calSignedBarycentricCoords(texCoords + vec2(0, pixelSize.y), rasterData.positionScreen), rasterData.invW) - uv;
 
-	vec3 normalWorld = (transpose(inverse(matrixModel)) * vec4(data.faceNormal, 0)).xyz;
+	const bool feedback = isFeedbackPixel();
+	vec3 normal = data.faceNormal;
+	if (data.material.normalTexIndex != 0x7FFFFFFF)
+	{
+		if (feedback) requestTexture(data.material.normalTexIndex, uvDx, uvDy);
+		const vec3 positions[3] = vec3[3](data.vertices[0].pos, data.vertices[1].pos, data.vertices[2].pos);
+		const vec3 normalTangent = textureGrad(textures[nonuniformEXT(data.material.normalTexIndex)], uv, uvDx, uvDy).xyz * 2 - 1;
+		normal = calTangentFrame(positions, uvs, normal) * normalTangent;
+		normal = length(normal) > 0 ? normal : data.faceNormal;
+	}
+	vec3 normalWorld = (instance.normalTransform * vec4(normal, 0)).xyz;
 	normalWorld = normalize(normalWorld);
 	vec3 dirLight = normalize(lightDirection);
 	float LdotN = max(dot(normalWorld, -dirLight), 0);
@@ -62,13 +106,39 @@ void main()
 	float RdotV = max(dot(dirRef, dirView), 0);
 
 	vec4 outColor = vec4(data.material.diffuse, 1);
+	if (feedback && data.material.diffuseTexIndex != 0x7FFFFFFF) requestTexture(data.material.diffuseTexIndex, uvDx, uvDy);
     outColor = (data.material.diffuseTexIndex != 0x7FFFFFFF) ? 
-			   texture(textures[nonuniformEXT(data.material.diffuseTexIndex)], uv) * (length(outColor) > 0 ? outColor : vec4(1))
+			   textureGrad(textures[nonuniformEXT(data.material.diffuseTexIndex)], uv, uvDx, uvDy) * (length(outColor) > 0 ? outColor : vec4(1))
 			   : outColor;
+	vec3 specular = data.material.specular;
+	float shininess = data.material.shininess;
+	// R: ambient occlusion, G: roughness, B: metallic, A: emission, the scalars are their factors
+	vec4 basicPBR = vec4(1);
+	if (data.material.basicPBRTexIndex != 0x7FFFFFFF)
+	{
+		if (feedback) requestTexture(data.material.basicPBRTexIndex, uvDx, uvDy);
+		basicPBR = textureGrad(textures[nonuniformEXT(data.material.basicPBRTexIndex)], uv, uvDx, uvDy);
+		// the same Phong approximation of the metallic-roughness model as the glTF loader's, per pixel
+		const float roughness = data.material.roughness * basicPBR.g;
+		const float metallic = data.material.metallic * basicPBR.b;
+		const float alpha = max(roughness * roughness, 1e-2);
+		shininess = max(2 / (alpha * alpha) - 2, 1);
+		specular = mix(vec3(.04), outColor.rgb, metallic) * (1 - roughness);
+		outColor.rgb *= 1 - metallic;
+	}
 	outColor *= LdotN;
-	outColor += vec4(data.material.specular, 1) * PhongNormalDistribution(RdotV, 1, data.material.shininess);
+	if (data.material.specularTexIndex != 0x7FFFFFFF)
+	{
+		// rgb scales the specular color, alpha holds the exponent map
+		if (feedback) requestTexture(data.material.specularTexIndex, uvDx, uvDy);
+		const vec4 specularTexel = textureGrad(textures[nonuniformEXT(data.material.specularTexIndex)], uv, uvDx, uvDy);
+		specular *= specularTexel.rgb;
+		shininess = max(shininess * specularTexel.a, 1);
+	}
+	outColor += vec4(specular, 1) * PhongNormalDistribution(RdotV, 1, shininess);
 	outColor *= lightIntensity;
-	outColor += vec4(0.17f, 0.37f, 0.65f, 1) * .1f;
+	outColor += vec4(0.17f, 0.37f, 0.65f, 1) * .1f * basicPBR.r;
+	outColor.rgb += data.material.emission * basicPBR.a;
 
 	fragColor = outColor;
 }
\ No newline at end of file
@@ -1,13 +1,12 @@
 #version 460
 
-#extension GL_GOOGLE_include_directive : enable
+layout(location = 0) flat in uint instanceIndex;
+layout(location = 1) flat in uint firstTriangle;
+layout(location = 0) out uvec2 visibility;
 
-#include "include/packing.glsl"
-
-layout(location = 0) flat in uint drawIndex;
-layout(location = 0) out vec4 fragColor;
+// x: 1 + the instance row, 0 is the cleared background; y: the triangle in the triangle buffers
 
 void main()
 {
-    fragColor = unpackUnorm4x8(((drawIndex & 255) << 23) | (gl_PrimitiveID & ((1 << 23) - 1)));
+    visibility = uvec2(instanceIndex + 1, firstTriangle + gl_PrimitiveID);
 }
\ No newline at end of file
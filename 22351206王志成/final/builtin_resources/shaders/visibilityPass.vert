@@ -1,21 +1,44 @@
 #version 460
 
 #extension GL_ARB_shader_draw_parameters : enable
+#extension GL_GOOGLE_include_directive : enable
 
-layout(location = 0) in vec3 pos;
-layout(location = 1) in vec3 normal;
-layout(location = 2) in vec2 texCoord;
+#include "include/layout.glsl"
+
+// both views alias the vertex buffer, vertexFormat tells which one is valid
+layout(set = 0, binding = 0) restrict readonly buffer VertexAttributes { VertexInput vertices[]; };
+layout(set = 0, binding = 0) restrict readonly buffer QuantizedVertexAttributes { uvec4 quantizedVertices[]; };
+layout(set = 0, binding = 4) restrict readonly buffer VertexBoundsAttributes { VertexBounds bounds[]; };
+layout(set = 0, binding = 5) restrict readonly buffer InstanceAttributes { InstanceAttribute instances[]; };
+layout(set = 0, binding = 7) restrict readonly buffer DrawCommands { DrawCommand draws[]; };
 layout(push_constant) uniform PushConstants 
 {
-    mat4 matrixModel;
     mat4 matrixView;
     mat4 matrixProj; 
+    float nearClip;
+    float farClip;
+    uint vertexFormat;
+    float _;
 };
 
-layout(location = 0) flat out uint drawIndex;
+// firstInstance of every draw is the index of its instance
+layout(location = 0) flat out uint instanceIndex;
+// first triangle of the draw in the merged buffers, gl_PrimitiveID restarts at 0 for every draw of the indirect list
+layout(location = 1) flat out uint firstTriangle;
+
+#include "include/packing.glsl"
 
 void main()
 {
-    gl_Position = matrixProj * matrixView * matrixModel * vec4(pos, 1.0);
-    drawIndex = gl_DrawIDARB;
+    vec3 pos;
+    if (vertexFormat == 1)
+    {
+        const uvec4 vertex = quantizedVertices[gl_VertexIndex];
+        pos = unpackQuantizedPosition(vertex, bounds[unpackBoundsIndex(vertex)]);
+    }
+    else
+        pos = vertices[gl_VertexIndex].slot0.xyz;
+    gl_Position = matrixProj * matrixView * instances[gl_InstanceIndex].transform * vec4(pos, 1.0);
+    instanceIndex = gl_InstanceIndex;
+    firstTriangle = draws[gl_DrawIDARB].firstTriangle;
 }
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include <stb_image.h>
 
 #include "modelLoader.h"
+#include "message.hpp"
 #include "application.h"
 
 void Application::setup(const nvvk::Context &context)
@@ -16,10 +17,11 @@ void Application::setup(const nvvk::Context &context)
 	m_allocator.init(context.m_instance, context.m_device, context.m_physicalDevice);
 
 	m_attachmentsContainer.init(m_device);
+	m_depthPyramidContainer.init(m_device);
 
 	m_dynamicColorAttachs.fill({VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO, nullptr});
 	m_dynamicDepthAttach.fill({VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO, nullptr});
-	VkClearValue colorClear{.0f, .0f, .0f, .0f};
+	VkClearValue colorClear{.color = {.uint32 = {0U, 0U, 0U, 0U}}};
 	VkClearValue depthClear{1.f, 0};
 	m_dynamicColorAttachs[0].imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 	m_dynamicColorAttachs[0].resolveMode = VK_RESOLVE_MODE_NONE;
@@ -36,9 +38,33 @@ void Application::setup(const nvvk::Context &context)
 	Scene::getInstance().m_allocatorHandle.init(context.m_instance, context.m_device, context.m_physicalDevice);
 	Scene::getInstance().m_transferQueueFamilyIndex = m_transferQueue.familyIndex;
 	Scene::getInstance().m_transferQueue = m_transferQueue.queue;
+	Scene::getInstance().m_graphicsQueueFamilyIndex = m_graphicsQueue.familyIndex;
+	Scene::getInstance().m_graphicsQueue = m_graphicsQueue.queue;
+	Scene::getInstance().m_uploader.init(m_device, Scene::getInstance().m_allocatorHandle.getStaging(), m_transferQueue.familyIndex, m_transferQueue.queue, m_graphicsQueue.familyIndex);
+	// textures are bound through one runtime sized array, its size is only bounded by the device
+	const auto &limits = context.m_physicalInfo.properties12;
+	Scene::getInstance().m_textureSetLimit = std::min({limits.maxDescriptorSetUpdateAfterBindSampledImages, limits.maxDescriptorSetUpdateAfterBindSamplers,
+														limits.maxPerStageDescriptorUpdateAfterBindSampledImages, limits.maxPerStageDescriptorUpdateAfterBindSamplers});
+
+	// load in background, meshes and textures are drawn as soon as they are streamed into the scene
+	const auto groupIndex = static_cast<uint32_t>(Scene::getInstance().m_objects.size());
 	Scene::getInstance().addObjectGroup({});
-	ModelLoader::getInstance().load(Scene::getInstance().m_objects.back(), Scene::getInstance().m_materials, Scene::getInstance().m_textures,
-									"builtin_resources/models/cgaxis_107_11_cafe_stall_obj.obj", "builtin_resources/textures", "", false);
+	Scene::getInstance().addInstance(groupIndex, nvmath::scale_mat4(nvmath::vec3f_one * .15f));
+	m_loadingProgress = std::make_shared<LoadingProgress>();
+	m_loadingProgress->onMaterialsLoaded = [groupIndex](const std::vector<Material> &materials, size_t textureCount)
+	{ Scene::getInstance().streamMaterials(groupIndex, materials, textureCount); };
+	m_loadingProgress->onMeshLoaded = [groupIndex](uint32_t, const Mesh &mesh)
+	{ Scene::getInstance().streamMesh(groupIndex, mesh); };
+	m_loadingProgress->onTextureLoaded = [groupIndex](uint32_t textureIndex, Texture &texture)
+	{ Scene::getInstance().streamTexture(groupIndex, textureIndex, texture); };
+	// BC7 is optional in Vulkan, textures stay uncompressed without it
+	VkFormatProperties bc7Properties{};
+	vkGetPhysicalDeviceFormatProperties(m_physicalDevice, VK_FORMAT_BC7_UNORM_BLOCK, &bc7Properties);
+	const bool supportsBC7 = (bc7Properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) != 0;
+	m_loadingBegin = std::chrono::steady_clock::now();
+	m_loadingTask = ModelLoader::getInstance().loadAsync(m_loadingProgress, "builtin_resources/models/cgaxis_107_11_cafe_stall_obj.obj", "builtin_resources/textures", "",
+														 {.interpVertexNormal = false, .optimizeMeshes = true, .buildMeshlets = true, .buildLods = true, .quantizeVertices = true, .compressTextures = supportsBC7});
+	MessageBox::getInstance().push("Loading cgaxis_107_11_cafe_stall_obj.obj ...");
 
 	printf("Init done.\n");
 }
@@ -46,7 +72,8 @@ void Application::setup(const nvvk::Context &context)
 void Application::createRenderer()
 {
 	// initialize
-	Scene::getInstance().prepareToDraw();
+	Scene::getInstance().m_textureSetFrameCount = getSwapChain().getImageCount();
+	Scene::getInstance().prepareToDraw(getCurFrame());
 	createDescriptors();
 	recreateRenderTarget();
 	createPipeline();
@@ -54,38 +81,130 @@ void Application::createRenderer()
 
 void Application::render(const VkCommandBuffer &cmdBuffer, nvvk::ProfilerVK &profiler)
 {
-	Scene::getInstance().prepareToDraw();
+	Scene::getInstance().m_textureBudget = static_cast<uint64_t>(m_textureBudgetMB) << 20;
+	Scene::getInstance().prepareToDraw(getCurFrame());
+	Scene::getInstance().cmdAcquireUploads(cmdBuffer);
+	Scene::getInstance().cmdUpdateInstances(cmdBuffer, getCurFrame());
 	nvvk::cmdBarrierImageLayout(cmdBuffer, m_visibilityBuffer.image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
 	nvvk::cmdBarrierImageLayout(cmdBuffer, m_depthBuffer.image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT);
 	m_visibilityBuffer.descriptor.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 	m_depthBuffer.descriptor.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
+	// the scene may still be empty while loading in background
+	const auto resident = Scene::getInstance().resident();
+	// the instances visible last frame are drawn first, the depth pyramid built from them tells which others are worth drawing
+	if (resident)
+	{
+		auto sec = profiler.timeRecurring("culling", cmdBuffer);
+		cullInstances(cmdBuffer, 0U);
+	}
+	drawVisibility(cmdBuffer, VK_ATTACHMENT_LOAD_OP_CLEAR);
+	if (resident)
+	{
+		{
+			auto sec = profiler.timeRecurring("occlusion culling", cmdBuffer);
+			nvvk::cmdBarrierImageLayout(cmdBuffer, m_depthBuffer.image, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT);
+			buildDepthPyramid(cmdBuffer);
+			nvvk::cmdBarrierImageLayout(cmdBuffer, m_depthBuffer.image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT);
+			cullInstances(cmdBuffer, 1U);
+		}
+		// the second phase loads the visibility buffer the first one wrote
+		VkMemoryBarrier colorBarrier = nvvk::make<VkMemoryBarrier>();
+		colorBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		colorBarrier.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, 1, &colorBarrier, 0, nullptr, 0, nullptr);
+		drawVisibility(cmdBuffer, VK_ATTACHMENT_LOAD_OP_LOAD);
+	}
+
+	nvvk::cmdBarrierImageLayout(cmdBuffer, m_visibilityBuffer.image, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	nvvk::cmdBarrierImageLayout(cmdBuffer, m_depthBuffer.image, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT);
+	m_visibilityBuffer.descriptor.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	m_depthBuffer.descriptor.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+}
+
+// every instance is tested against the frustum on the GPU, the visible ones append their draw at the selected level
+// those drawn at full resolution are then expanded to their meshlets by a second dispatch, sized by the first one
+void Application::cullInstances(const VkCommandBuffer &cmdBuffer, uint32_t phase)
+{
+	CullingConstants culling{};
+	culling.matrixView = m_pushConstants.matrixView;
+	culling.matrixProjection = m_pushConstants.matrixProjection;
+	culling.cameraPosition = nvmath::vec4(CameraManip.getEye(), 1.f);
+	culling.pixelScale = m_pushConstants.matrixProjection.a11 * m_size.height * .5f;
+	culling.maxPixelError = m_maxLodPixelError;
+	culling.instanceCount = Scene::getInstance().instanceRowCount();
+	culling.phase = phase;
+	culling.occlusionCulling = m_occlusionCulling ? 1U : 0U;
+	culling.meshletCulling = m_meshletCulling ? 1U : 0U;
+	Scene::getInstance().cmdBeginCulling(cmdBuffer, phase == 0U);
+	std::array<VkDescriptorSet, 2> sets{Scene::getInstance().m_geometrySet, m_attachmentsContainer.getSet()};
+	vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_cullingPipeline);
+	vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_cullingPipelineLayout, 0, sets.size(), sets.data(), 0, nullptr);
+	vkCmdPushConstants(cmdBuffer, m_cullingPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullingConstants), &culling);
+	vkCmdDispatch(cmdBuffer, (culling.instanceCount + 63) / 64, 1, 1);
+	Scene::getInstance().cmdCullingBarrier(cmdBuffer);
+	vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_meshletCullingPipeline);
+	vkCmdDispatchIndirect(cmdBuffer, Scene::getInstance().drawCountBuffer(), Scene::getInstance().clusterDispatchOffset());
+	Scene::getInstance().cmdEndCulling(cmdBuffer);
+}
+
+// the draws the last culling phase kept, loadOp tells whether the phase adds to the previous one's attachments
+void Application::drawVisibility(const VkCommandBuffer &cmdBuffer, VkAttachmentLoadOp loadOp)
+{
 	VkViewport viewport{0, 0, m_size.width, m_size.height, 0, 1};
 	VkRect2D scissor{{0, 0}, m_size};
 
+	m_dynamicColorAttachs[0].loadOp = loadOp;
+	m_dynamicDepthAttach[0].loadOp = loadOp;
 	vkCmdBeginRendering(cmdBuffer, &m_dynamicRenderingInfo);
 
 	vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_visibilityPipeline);
 	vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
 	vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
 
+	m_pushConstants.vertexFormat = Scene::getInstance().m_quantizedVertices ? 1U : 0U;
 	vkCmdPushConstants(cmdBuffer, m_visibilityPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushConstants), &m_pushConstants);
 
-	VkDeviceSize offset{};
-	vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &Scene::getInstance().m_vertexBuffer.buffer, &offset);
-	vkCmdBindIndexBuffer(cmdBuffer, Scene::getInstance().m_indexBuffer.buffer, offset, VkIndexType::VK_INDEX_TYPE_UINT32);
-	vkCmdDrawIndexed(cmdBuffer, Scene::getInstance().m_totalVertexCount, 3, 0, 0, 0);
+	if (Scene::getInstance().resident())
+	{
+		// vertices are pulled from the geometry set, as their layout depends on the scene
+		VkDeviceSize offset{};
+		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_visibilityPipelineLayout, 0, 1, &Scene::getInstance().m_geometrySet, 0, nullptr);
+		vkCmdBindIndexBuffer(cmdBuffer, Scene::getInstance().indexBuffer(), offset, VkIndexType::VK_INDEX_TYPE_UINT32);
+		// firstInstance is the instance, the shaders rebuild global triangle indices from the draw's first one
+		vkCmdDrawIndexedIndirectCount(cmdBuffer, Scene::getInstance().drawBuffer(), 0, Scene::getInstance().drawCountBuffer(), 0,
+									  Scene::getInstance().maxDrawCount(), sizeof(DrawCommand));
+	}
 
 	vkCmdEndRendering(cmdBuffer);
+}
 
-	nvvk::cmdBarrierImageLayout(cmdBuffer, m_visibilityBuffer.image, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-	nvvk::cmdBarrierImageLayout(cmdBuffer, m_depthBuffer.image, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT);
-	m_visibilityBuffer.descriptor.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-	m_depthBuffer.descriptor.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+// level 0 reduces the depth buffer, every other level the one above it
+void Application::buildDepthPyramid(const VkCommandBuffer &cmdBuffer)
+{
+	VkMemoryBarrier barrier = nvvk::make<VkMemoryBarrier>();
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_depthPyramidPipeline);
+	DepthPyramidConstants constants{};
+	constants.sourceSize = nvmath::vec2i(m_size.width, m_size.height);
+	for (auto level = 0U; level < m_depthPyramidLevels.size(); ++level)
+	{
+		constants.destinationSize = nvmath::vec2i(std::max(m_depthPyramidSize.width >> level, 1U), std::max(m_depthPyramidSize.height >> level, 1U));
+		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_depthPyramidPipelineLayout, 0, 1, m_depthPyramidContainer.getSets(level), 0, nullptr);
+		vkCmdPushConstants(cmdBuffer, m_depthPyramidPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(DepthPyramidConstants), &constants);
+		vkCmdDispatch(cmdBuffer, (constants.destinationSize.x + 7) / 8, (constants.destinationSize.y + 7) / 8, 1);
+		vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+		constants.sourceSize = constants.destinationSize;
+	}
 }
 
 void Application::finalBlit(const VkCommandBuffer &cmdBuffer, nvvk::ProfilerVK &profiler)
 {
+	// geometry descriptors are not written before anything is resident
+	if (!Scene::getInstance().resident())
+		return;
+
 	VkViewport viewport{0, 0, m_size.width, m_size.height, 0, 1};
 	VkRect2D scissor{{0, 0}, m_size};
 
@@ -99,8 +218,46 @@ void Application::finalBlit(const VkCommandBuffer &cmdBuffer, nvvk::ProfilerVK &
 	vkCmdDraw(cmdBuffer, 3, 1, 0, 0);
 }
 
+void Application::finishFrame(const VkCommandBuffer &cmdBuffer)
+{
+	// the texture requests of the shading pass are read back once this frame's fence is waited on again
+	Scene::getInstance().cmdResolveFeedback(cmdBuffer, getCurFrame());
+	Scene::getInstance().cmdResolveDrawCounts(cmdBuffer, getCurFrame());
+}
+
+// same as AppBaseVk's (without NVLINK), the frame also waits for the scene uploads it acquired
+void Application::submitFrame()
+{
+	const auto imageIndex = m_swapChain.getActiveImageIndex();
+	vkResetFences(m_device, 1, &m_waitFences[imageIndex]);
+
+	const std::array<VkSemaphore, 2> waitSemaphores{m_swapChain.getActiveReadSemaphore(), Scene::getInstance().m_uploader.getSemaphore()};
+	// the binary semaphore's value is ignored
+	const std::array<uint64_t, 2> waitValues{0ULL, Scene::getInstance().m_uploader.getWaitValue()};
+	const std::array<VkPipelineStageFlags, 2> waitStages{VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT};
+	const VkSemaphore signalSemaphore = m_swapChain.getActiveWrittenSemaphore();
+
+	VkTimelineSemaphoreSubmitInfo timelineInfo = nvvk::make<VkTimelineSemaphoreSubmitInfo>();
+	timelineInfo.waitSemaphoreValueCount = waitValues.size();
+	timelineInfo.pWaitSemaphoreValues = waitValues.data();
+	VkSubmitInfo submitInfo = nvvk::make<VkSubmitInfo>();
+	submitInfo.pNext = &timelineInfo;
+	submitInfo.waitSemaphoreCount = waitSemaphores.size();
+	submitInfo.pWaitSemaphores = waitSemaphores.data();
+	submitInfo.pWaitDstStageMask = waitStages.data();
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &m_commandBuffers[imageIndex];
+	submitInfo.signalSemaphoreCount = 1;
+	submitInfo.pSignalSemaphores = &signalSemaphore;
+	NVVK_CHECK(vkQueueSubmit(m_queue, 1, &submitInfo, m_waitFences[imageIndex]));
+
+	m_swapChain.present(m_queue);
+}
+
 void Application::renderGUI(nvvk::ProfilerVK &profiler)
 {
+	updateLoading();
+	renderMessages();
 
 	// update title for every 1 sec
 	static float dirtyTimer = .0f;
@@ -191,7 +348,21 @@ void Application::renderGUI(nvvk::ProfilerVK &profiler)
 					ImGuiH::PropertyEditor::end();
 				}
 				else if (m_selectedObject == -2)
+				{
 					ImGuiH::CameraWidget();
+					ImGuiH::PropertyEditor::begin();
+					ImGuiH::PropertyEditor::entry("LOD error (px)", [&]()
+												  { return ImGui::SliderFloat("##lodError", &m_maxLodPixelError, 0.f, 8.f); });
+					ImGuiH::PropertyEditor::entry("occlusion culling", [&]()
+												  { return ImGui::Checkbox("##occlusionCulling", &m_occlusionCulling); });
+					ImGuiH::PropertyEditor::entry("meshlet culling", [&]()
+												  { return ImGui::Checkbox("##meshletCulling", &m_meshletCulling); });
+					ImGuiH::PropertyEditor::entry("texture budget (MB)", [&]()
+												  { return ImGui::SliderInt("##textureBudget", &m_textureBudgetMB, 64, 16384); });
+					ImGuiH::PropertyEditor::entry("resident textures (MB)", [&]()
+												  { ImGui::Text("%.1f", Scene::getInstance().residentTextureBytes() / 1048576.); return false; });
+					ImGuiH::PropertyEditor::end();
+				}
 				ImGui::EndTabItem();
 			}
 
@@ -217,7 +388,6 @@ void Application::updateBuffers(const VkCommandBuffer &cmdBuffer)
 	// update CameraProperty (Push Constants)
 	const auto &matView = CameraManip.getMatrix();
 	const auto &matProj = nvmath::perspectiveVK(CameraManip.getFov(), (float)m_size.height / m_size.width, CameraManip.getClipPlanes().x, CameraManip.getClipPlanes().y);
-	m_pushConstants.matrixModel = nvmath::scale_mat4(nvmath::vec3f_one * .15f);
 	m_pushConstants.matrixView = matView;
 	m_pushConstants.matrixProjection = matProj;
 	m_pushConstants.nearClip = CameraManip.getClipPlanes().x;
@@ -236,16 +406,38 @@ void Application::recreateRenderTarget()
 		m_visibilityBuffer.descriptor.sampler = VK_NULL_HANDLE;
 		m_allocator.destroy(m_depthBuffer);
 	}
+	if (m_depthPyramid.memHandle != nullptr)
+	{
+		for (auto view : m_depthPyramidLevels)
+			vkDestroyImageView(m_device, view, VK_NULL_HANDLE);
+		m_depthPyramid.descriptor.sampler = VK_NULL_HANDLE;
+		m_allocator.destroy(m_depthPyramid);
+	}
 
-	auto visibilityBufferImage = m_allocator.createImage(nvvk::makeImage2DCreateInfo({m_size.width, m_size.height}, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT));
+	auto visibilityBufferImage = m_allocator.createImage(nvvk::makeImage2DCreateInfo({m_size.width, m_size.height}, visibilityFormat, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT));
 	m_visibilityBuffer = m_allocator.createTexture(visibilityBufferImage, nvvk::makeImage2DViewCreateInfo(visibilityBufferImage.image));
 	m_visibilityBuffer.descriptor.sampler = m_defaultBufferImageSampler;
 	auto depthBufferImage = m_allocator.createImage(nvvk::makeImage2DCreateInfo({m_size.width, m_size.height}, m_depthFormat, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT));
 	m_depthBuffer = m_allocator.createTexture(depthBufferImage, nvvk::makeImage2DViewCreateInfo(depthBufferImage.image, m_depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT));
 	m_depthBuffer.descriptor.sampler = m_defaultBufferImageSampler;
 
+	// the pyramid stays in GENERAL, its levels are written as storage images & sampled by the culling pass
+	m_depthPyramidSize = {1U << (std::bit_width(m_size.width) - 1), 1U << (std::bit_width(m_size.height) - 1)};
+	auto depthPyramidImage = m_allocator.createImage(nvvk::makeImage2DCreateInfo(m_depthPyramidSize, VK_FORMAT_R32_SFLOAT, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, true));
+	m_depthPyramid = m_allocator.createTexture(depthPyramidImage, nvvk::makeImage2DViewCreateInfo(depthPyramidImage.image, VK_FORMAT_R32_SFLOAT));
+	m_depthPyramid.descriptor.sampler = m_defaultBufferImageSampler;
+	m_depthPyramid.descriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+	m_depthPyramidLevels.resize(nvvk::mipLevels(m_depthPyramidSize));
+	for (auto level = 0U; level < m_depthPyramidLevels.size(); ++level)
+	{
+		auto viewInfo = nvvk::makeImage2DViewCreateInfo(depthPyramidImage.image, VK_FORMAT_R32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+		viewInfo.subresourceRange.baseMipLevel = level;
+		NVVK_CHECK(vkCreateImageView(m_device, &viewInfo, VK_NULL_HANDLE, &m_depthPyramidLevels[level]));
+	}
+
 	{
 		nvvk::ScopeCommandBuffer scopedBuffer(m_device, m_graphicsQueue.familyIndex, m_graphicsQueue.queue);
+		nvvk::cmdBarrierImageLayout(scopedBuffer, m_depthPyramid.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
 		nvvk::cmdBarrierImageLayout(scopedBuffer, m_visibilityBuffer.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 		nvvk::cmdBarrierImageLayout(scopedBuffer, m_depthBuffer.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT);
 		m_visibilityBuffer.descriptor.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
@@ -258,6 +450,17 @@ void Application::recreateRenderTarget()
 		std::vector<VkWriteDescriptorSet> writeDescs{};
 		writeDescs.emplace_back(m_attachmentsContainer.makeWrite(0, 0, &m_visibilityBuffer.descriptor));
 		writeDescs.emplace_back(m_attachmentsContainer.makeWrite(0, 1, &m_depthBuffer.descriptor));
+		writeDescs.emplace_back(m_attachmentsContainer.makeWrite(0, 2, &m_depthPyramid.descriptor));
+		m_depthPyramidContainer.deinitPool();
+		m_depthPyramidContainer.initPool(m_depthPyramidLevels.size());
+		std::vector<VkDescriptorImageInfo> levelInfos(2 * m_depthPyramidLevels.size());
+		for (auto level = 0U; level < m_depthPyramidLevels.size(); ++level)
+		{
+			levelInfos[2 * level] = level == 0U ? m_depthBuffer.descriptor : VkDescriptorImageInfo{m_defaultBufferImageSampler, m_depthPyramidLevels[level - 1], VK_IMAGE_LAYOUT_GENERAL};
+			levelInfos[2 * level + 1] = {VK_NULL_HANDLE, m_depthPyramidLevels[level], VK_IMAGE_LAYOUT_GENERAL};
+			writeDescs.emplace_back(m_depthPyramidContainer.makeWrite(level, 0, &levelInfos[2 * level]));
+			writeDescs.emplace_back(m_depthPyramidContainer.makeWrite(level, 1, &levelInfos[2 * level + 1]));
+		}
 		vkUpdateDescriptorSets(m_device, writeDescs.size(), writeDescs.data(), 0, nullptr);
 	}
 
@@ -273,13 +476,19 @@ void Application::recreateRenderTarget()
 
 void Application::createDescriptors()
 {
+	// attachments are only read with texelFetch, the integer visibility buffer can't be filtered anyway
 	if (m_defaultBufferImageSampler == VK_NULL_HANDLE)
-		m_defaultBufferImageSampler = m_allocator.acquireSampler(nvvk::makeSamplerCreateInfo());
+		m_defaultBufferImageSampler = m_allocator.acquireSampler(nvvk::makeSamplerCreateInfo(VK_FILTER_NEAREST, VK_FILTER_NEAREST));
 
 	m_attachmentsContainer.addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, &m_defaultBufferImageSampler);
 	m_attachmentsContainer.addBinding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, &m_defaultBufferImageSampler);
+	m_attachmentsContainer.addBinding(2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT, &m_defaultBufferImageSampler);
 	m_attachmentsContainer.initLayout();
 	m_attachmentsContainer.initPool(1);
+
+	m_depthPyramidContainer.addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT, &m_defaultBufferImageSampler);
+	m_depthPyramidContainer.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+	m_depthPyramidContainer.initLayout();
 }
 
 void Application::createPipeline()
@@ -288,11 +497,18 @@ void Application::createPipeline()
 	vkDestroyPipeline(m_device, m_visibilityPipeline, VK_NULL_HANDLE);
 	vkDestroyPipelineLayout(m_device, m_shadingPipelineLayout, VK_NULL_HANDLE);
 	vkDestroyPipeline(m_device, m_shadingPipeline, VK_NULL_HANDLE);
+	vkDestroyPipelineLayout(m_device, m_cullingPipelineLayout, VK_NULL_HANDLE);
+	vkDestroyPipeline(m_device, m_cullingPipeline, VK_NULL_HANDLE);
+	vkDestroyPipeline(m_device, m_meshletCullingPipeline, VK_NULL_HANDLE);
+	vkDestroyPipelineLayout(m_device, m_depthPyramidPipelineLayout, VK_NULL_HANDLE);
+	vkDestroyPipeline(m_device, m_depthPyramidPipeline, VK_NULL_HANDLE);
 
 	VkPushConstantRange pushConstantRange = {VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushConstants)};
 	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = nvvk::make<VkPipelineLayoutCreateInfo>();
 	pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
 	pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+	pipelineLayoutCreateInfo.setLayoutCount = 1;
+	pipelineLayoutCreateInfo.pSetLayouts = &Scene::getInstance().m_geometrySetLayout;
 	NVVK_CHECK(vkCreatePipelineLayout(m_device, &pipelineLayoutCreateInfo, VK_NULL_HANDLE, &m_visibilityPipelineLayout));
 	std::array<VkDescriptorSetLayout, 3> mergedLayouts{};
 	mergedLayouts[0] = Scene::getInstance().m_geometrySetLayout;
@@ -302,7 +518,7 @@ void Application::createPipeline()
 	pipelineLayoutCreateInfo.pSetLayouts = mergedLayouts.data();
 	NVVK_CHECK(vkCreatePipelineLayout(m_device, &pipelineLayoutCreateInfo, VK_NULL_HANDLE, &m_shadingPipelineLayout));
 
-	std::array<VkFormat, 1> dynamicColorAttachFormat{VK_FORMAT_R8G8B8A8_UNORM};
+	std::array<VkFormat, 1> dynamicColorAttachFormat{visibilityFormat};
 	VkPipelineRenderingCreateInfo pipelineRenderingInfo{VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO, nullptr};
 	pipelineRenderingInfo.colorAttachmentCount = m_dynamicColorAttachs.size();
 	pipelineRenderingInfo.pColorAttachmentFormats = dynamicColorAttachFormat.data();
@@ -312,10 +528,6 @@ void Application::createPipeline()
 	nvvk::GraphicsPipelineGeneratorCombined visibilityPipelineHelper(m_device, m_visibilityPipelineLayout, VK_NULL_HANDLE);
 	visibilityPipelineHelper.addShader(nvh::loadFile("builtin_resources/shaders/visibilityPass.vert.spv", true), VK_SHADER_STAGE_VERTEX_BIT);
 	visibilityPipelineHelper.addShader(nvh::loadFile("builtin_resources/shaders/visibilityPass.frag.spv", true), VK_SHADER_STAGE_FRAGMENT_BIT);
-	visibilityPipelineHelper.addBindingDescription(visibilityPipelineHelper.makeVertexInputBinding(0, sizeof(VertexAttribute)));
-	visibilityPipelineHelper.addAttributeDescription(visibilityPipelineHelper.makeVertexInputAttribute(0, 0, VkFormat::VK_FORMAT_R32G32B32_SFLOAT, offsetof(VertexAttribute, position)));
-	visibilityPipelineHelper.addAttributeDescription(visibilityPipelineHelper.makeVertexInputAttribute(1, 0, VkFormat::VK_FORMAT_R32G32B32_SFLOAT, offsetof(VertexAttribute, normal)));
-	visibilityPipelineHelper.addAttributeDescription(visibilityPipelineHelper.makeVertexInputAttribute(2, 0, VkFormat::VK_FORMAT_R32G32_SFLOAT, offsetof(VertexAttribute, uv)));
 	visibilityPipelineHelper.setPipelineRenderingCreateInfo(pipelineRenderingInfo);
 	m_visibilityPipeline = visibilityPipelineHelper.createPipeline();
 
@@ -324,6 +536,37 @@ void Application::createPipeline()
 	shadingPipelineHelper.addShader(nvh::loadFile("builtin_resources/shaders/shadingPass.frag.spv", true), VK_SHADER_STAGE_FRAGMENT_BIT);
 	shadingPipelineHelper.rasterizationState.cullMode = VK_CULL_MODE_NONE;
 	m_shadingPipeline = shadingPipelineHelper.createPipeline();
+
+	// the culling pass reads the depth pyramid from the attachments set
+	VkPushConstantRange cullingConstantRange = {VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullingConstants)};
+	pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+	pipelineLayoutCreateInfo.pPushConstantRanges = &cullingConstantRange;
+	pipelineLayoutCreateInfo.setLayoutCount = 2;
+	pipelineLayoutCreateInfo.pSetLayouts = mergedLayouts.data();
+	NVVK_CHECK(vkCreatePipelineLayout(m_device, &pipelineLayoutCreateInfo, VK_NULL_HANDLE, &m_cullingPipelineLayout));
+	VkComputePipelineCreateInfo computePipelineInfo = nvvk::make<VkComputePipelineCreateInfo>();
+	computePipelineInfo.layout = m_cullingPipelineLayout;
+	computePipelineInfo.stage = nvvk::make<VkPipelineShaderStageCreateInfo>();
+	computePipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	computePipelineInfo.stage.module = nvvk::createShaderModule(m_device, nvh::loadFile("builtin_resources/shaders/cullingPass.comp.spv", true));
+	computePipelineInfo.stage.pName = "main";
+	NVVK_CHECK(vkCreateComputePipelines(m_device, VK_NULL_HANDLE, 1, &computePipelineInfo, VK_NULL_HANDLE, &m_cullingPipeline));
+	vkDestroyShaderModule(m_device, computePipelineInfo.stage.module, VK_NULL_HANDLE);
+	// the meshlet pass shares the culling pass' layout & push constants
+	computePipelineInfo.stage.module = nvvk::createShaderModule(m_device, nvh::loadFile("builtin_resources/shaders/meshletCulling.comp.spv", true));
+	NVVK_CHECK(vkCreateComputePipelines(m_device, VK_NULL_HANDLE, 1, &computePipelineInfo, VK_NULL_HANDLE, &m_meshletCullingPipeline));
+	vkDestroyShaderModule(m_device, computePipelineInfo.stage.module, VK_NULL_HANDLE);
+
+	VkPushConstantRange depthPyramidConstantRange = {VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(DepthPyramidConstants)};
+	const auto depthPyramidLayout = m_depthPyramidContainer.getLayout();
+	pipelineLayoutCreateInfo.pPushConstantRanges = &depthPyramidConstantRange;
+	pipelineLayoutCreateInfo.setLayoutCount = 1;
+	pipelineLayoutCreateInfo.pSetLayouts = &depthPyramidLayout;
+	NVVK_CHECK(vkCreatePipelineLayout(m_device, &pipelineLayoutCreateInfo, VK_NULL_HANDLE, &m_depthPyramidPipelineLayout));
+	computePipelineInfo.layout = m_depthPyramidPipelineLayout;
+	computePipelineInfo.stage.module = nvvk::createShaderModule(m_device, nvh::loadFile("builtin_resources/shaders/depthPyramid.comp.spv", true));
+	NVVK_CHECK(vkCreateComputePipelines(m_device, VK_NULL_HANDLE, 1, &computePipelineInfo, VK_NULL_HANDLE, &m_depthPyramidPipeline));
+	vkDestroyShaderModule(m_device, computePipelineInfo.stage.module, VK_NULL_HANDLE);
 }
 
 bool Application::guiProfilerMeasures(nvvk::ProfilerVK &profiler)
@@ -360,28 +603,104 @@ bool Application::guiProfilerMeasures(nvvk::ProfilerVK &profiler)
 	ImGui::Text("Frame time: %.3f[ms]", display.frameTime);
 	ImGui::Text("Rendering time(GPU/CPU): %.3f / %.3f[ms]", display.statRender.x, display.statRender.y);
 	ImGui::ProgressBar(display.statRender.x / display.frameTime);
+	// counted by the GPU, read back a few frames later
+	ImGui::Text("Instances drawn / culled / occluded: %u / %u / %u", Scene::getInstance().drawnInstanceCount(), Scene::getInstance().culledInstanceCount(),
+				Scene::getInstance().occludedInstanceCount());
+	ImGui::Text("Meshlets drawn / culled / occluded: %u / %u / %u", Scene::getInstance().drawnMeshletCount(), Scene::getInstance().culledMeshletCount(),
+				Scene::getInstance().occludedMeshletCount());
 	ImGui::Spacing();
 	ImGui::TextWrapped("Current average rendering time %.3f ms / %.1F FPS", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
 
 	return false;
 }
 
+void Application::updateLoading()
+{
+	m_messageTimer = std::max(.0f, m_messageTimer - ImGui::GetIO().DeltaTime);
+	if (!m_loadingProgress)
+		return;
+
+	MessageBox::getInstance().setProgress(m_loadingProgress->progress());
+	if (!m_loadingProgress->finished())
+		return;
+
+	try
+	{
+		m_loadingTask.get();
+		const auto seconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - m_loadingBegin).count();
+		char message[64];
+		snprintf(message, sizeof(message), m_loadingProgress->cancelled() ? "Loading cancelled after %.2fs." : "Loading finished in %.2fs.", seconds);
+		MessageBox::getInstance().push(message);
+	}
+	catch (const std::exception &e)
+	{
+		printf("ERROR: failed to load scene: %s\n", e.what());
+		MessageBox::getInstance().push(std::string("Loading failed: ") + e.what());
+	}
+	MessageBox::getInstance().setProgress(-1.f);
+	m_loadingProgress.reset();
+	m_messageTimer = 5.f;
+}
+
+void Application::renderMessages()
+{
+	if (!m_loadingProgress && m_messageTimer <= .0f)
+		return;
+
+	ImGui::SetNextWindowPos(ImVec2(ImGui::GetIO().DisplaySize.x - 10.f, 10.f), ImGuiCond_Always, ImVec2(1.f, 0.f));
+	ImGui::SetNextWindowBgAlpha(.6f);
+	const auto flags = ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoFocusOnAppearing | ImGuiWindowFlags_NoNav;
+	if (ImGui::Begin("Messages", nullptr, flags))
+	{
+		for (const auto &line : MessageBox::getInstance().getMessages())
+			ImGui::TextUnformatted(line.c_str());
+
+		const auto progress = MessageBox::getInstance().getProgress();
+		if (m_loadingProgress && progress >= .0f)
+		{
+			ImGui::ProgressBar(progress, ImVec2(320.f, 0.f), m_loadingProgress->stage().c_str());
+			if (ImGui::Button("Cancel"))
+				m_loadingProgress->cancel();
+		}
+	}
+	ImGui::End();
+}
+
 void Application::destroyResources()
 {
+	// the loader streams into the scene, so it has to stop before the scene is released
+	if (m_loadingProgress)
+	{
+		m_loadingProgress->cancel();
+		m_loadingTask.wait();
+		m_loadingProgress.reset();
+	}
+
 	m_allocator.releaseSampler(m_defaultBufferImageSampler);
 	m_visibilityBuffer.descriptor.sampler = VK_NULL_HANDLE;
 	m_depthBuffer.descriptor.sampler = VK_NULL_HANDLE;
+	m_depthPyramid.descriptor.sampler = VK_NULL_HANDLE;
 	if (m_visibilityBuffer.memHandle != nullptr)
 		m_allocator.destroy(m_visibilityBuffer);
 	if (m_depthBuffer.memHandle != nullptr)
 		m_allocator.destroy(m_depthBuffer);
+	for (auto view : m_depthPyramidLevels)
+		vkDestroyImageView(m_device, view, VK_NULL_HANDLE);
+	if (m_depthPyramid.memHandle != nullptr)
+		m_allocator.destroy(m_depthPyramid);
 
 	vkDestroyPipelineLayout(m_device, m_visibilityPipelineLayout, VK_NULL_HANDLE);
 	vkDestroyPipeline(m_device, m_visibilityPipeline, VK_NULL_HANDLE);
 	vkDestroyPipelineLayout(m_device, m_shadingPipelineLayout, VK_NULL_HANDLE);
 	vkDestroyPipeline(m_device, m_shadingPipeline, VK_NULL_HANDLE);
+	vkDestroyPipelineLayout(m_device, m_cullingPipelineLayout, VK_NULL_HANDLE);
+	vkDestroyPipeline(m_device, m_cullingPipeline, VK_NULL_HANDLE);
+	vkDestroyPipeline(m_device, m_meshletCullingPipeline, VK_NULL_HANDLE);
+	vkDestroyPipelineLayout(m_device, m_depthPyramidPipelineLayout, VK_NULL_HANDLE);
+	vkDestroyPipeline(m_device, m_depthPyramidPipeline, VK_NULL_HANDLE);
 
 	m_attachmentsContainer.deinit();
+	m_depthPyramidContainer.deinit();
 	m_allocator.deinit();
 	Scene::getInstance().deinit();
 }
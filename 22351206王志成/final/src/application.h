@@ -1,5 +1,9 @@
 #pragma once
 
+#include <chrono>
+#include <future>
+#include <memory>
+
 #include <nvvkhl/appbase_vk.hpp>
 #include <nvvk/context_vk.hpp>
 #include <nvvk/structs_vk.hpp>
@@ -13,23 +17,46 @@
 
 #include "scene.hpp"
 
+class LoadingProgress;
+
 using Allocator = nvvk::ResourceAllocatorVma;
 
 constexpr uint32_t renderWidth = 1024;
 constexpr uint32_t renderHeight = 768;
+// per pixel: 1 + the instance row (0 where nothing was drawn) & the triangle, full 32 bits each
+constexpr VkFormat visibilityFormat = VK_FORMAT_R32G32_UINT;
 
 struct alignas(16) PushConstants
 {
-	nvmath::mat4 matrixModel;
 	nvmath::mat4 matrixView;
 	nvmath::mat4 matrixProjection;
 	float nearClip;
 	float farClip;
-	nvmath::vec2 _;
+	uint32_t vertexFormat; // 0 for VertexAttribute, 1 for QuantizedVertex
+	float _;
 	nvmath::vec3 lightDirection{1, 1, 0};
 	float lightIntensity{1};
 };
 
+struct alignas(16) CullingConstants
+{
+	nvmath::mat4 matrixView;
+	nvmath::mat4 matrixProjection;
+	nvmath::vec4 cameraPosition; // w unused
+	float pixelScale; // size in pixels of one view space unit at depth 1
+	float maxPixelError;
+	uint32_t instanceCount;
+	uint32_t phase; // 0 redraws the instances visible last frame, 1 tests the others against the depth pyramid
+	uint32_t occlusionCulling;
+	uint32_t meshletCulling; // instances drawn at full resolution are culled & drawn per meshlet
+};
+
+struct DepthPyramidConstants
+{
+	nvmath::vec2i sourceSize;
+	nvmath::vec2i destinationSize;
+};
+
 class Application : public nvvkhl::AppBaseVk
 {
 public:
@@ -39,6 +66,9 @@ public:
 	void render(const VkCommandBuffer &cmdBuffer, nvvk::ProfilerVK &profiler);
 	void finalBlit(const VkCommandBuffer &cmdBuffer, nvvk::ProfilerVK &profiler);
 	void renderGUI(nvvk::ProfilerVK &profiler);
+	// commands after the final blit's render pass
+	void finishFrame(const VkCommandBuffer &cmdBuffer);
+	void submitFrame() override;
 
 	void updateBuffers(const VkCommandBuffer &cmdBuffer);
 
@@ -48,8 +78,13 @@ private:
 	void recreateRenderTarget();
 	void createDescriptors();
 	void createPipeline();
+	void cullInstances(const VkCommandBuffer &cmdBuffer, uint32_t phase);
+	void drawVisibility(const VkCommandBuffer &cmdBuffer, VkAttachmentLoadOp loadOp);
+	void buildDepthPyramid(const VkCommandBuffer &cmdBuffer);
 
 	bool guiProfilerMeasures(nvvk::ProfilerVK &profiler);
+	void updateLoading();
+	void renderMessages();
 
 	nvvk::Context::Queue m_graphicsQueue{};
 	nvvk::Context::Queue m_computeQueue{};
@@ -59,6 +94,11 @@ private:
 
 	nvvk::Texture m_visibilityBuffer{};
 	nvvk::Texture m_depthBuffer{};
+	// farthest depth of the visibility pass, halved per level from the largest powers of two within the render size
+	nvvk::Texture m_depthPyramid{};
+	std::vector<VkImageView> m_depthPyramidLevels{};
+	VkExtent2D m_depthPyramidSize{};
+	nvvk::DescriptorSetContainer m_depthPyramidContainer{}; // one set per level, reading the level above
 	VkSampler m_defaultBufferImageSampler{};
 	nvvk::DescriptorSetContainer m_attachmentsContainer{};
 	VkRenderingInfo m_dynamicRenderingInfo{VK_STRUCTURE_TYPE_RENDERING_INFO, nullptr, 0};
@@ -69,8 +109,25 @@ private:
 	VkPipeline m_visibilityPipeline{VK_NULL_HANDLE};
 	VkPipelineLayout m_shadingPipelineLayout{VK_NULL_HANDLE};
 	VkPipeline m_shadingPipeline{VK_NULL_HANDLE};
+	VkPipelineLayout m_cullingPipelineLayout{VK_NULL_HANDLE};
+	VkPipeline m_cullingPipeline{VK_NULL_HANDLE};
+	VkPipeline m_meshletCullingPipeline{VK_NULL_HANDLE};
+	VkPipelineLayout m_depthPyramidPipelineLayout{VK_NULL_HANDLE};
+	VkPipeline m_depthPyramidPipeline{VK_NULL_HANDLE};
 
 	PushConstants m_pushConstants{};
+	// meshes switch to a coarser level once its error projects below this many pixels, 0 always draws full resolution
+	float m_maxLodPixelError{1.f};
+	bool m_occlusionCulling{true};
+	bool m_meshletCulling{true};
+	// GPU memory the streamed texture levels may use
+	int m_textureBudgetMB{1024};
+
+	// background scene loading
+	std::shared_ptr<LoadingProgress> m_loadingProgress{};
+	std::future<void> m_loadingTask{};
+	std::chrono::steady_clock::time_point m_loadingBegin{};
+	float m_messageTimer{.0f}; // keeps the message overlay visible for a while after loading
 
 	// interactive
 	int m_selectedObject{-1}; // -3 for light, -2 for camera, -1 for none, 0...max to model parts
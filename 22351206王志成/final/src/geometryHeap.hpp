@@ -0,0 +1,153 @@
+#pragma once
+
+#include <map>
+#include <vector>
+
+#include <nvh/trangeallocator.hpp>
+#include <nvvk/resourceallocator_vk.hpp>
+
+/* device buffers sub-allocated in elements, objects are added & removed without touching the others' data */
+// several streams share one range allocator: a range holds count elements at offset in every stream's buffer (e.g. faces & indices)
+// full buffers are doubled and their content copied over on the GPU, freed ranges wait for the frames in flight before being reused
+class GeometryHeap
+{
+public:
+    void init(nvvk::ResourceAllocator *allocator, const std::vector<uint32_t> &elementSizes, VkBufferUsageFlags usage)
+    {
+        m_allocator = allocator;
+        m_elementSizes = elementSizes;
+        m_usage = usage | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        m_buffers.assign(elementSizes.size(), {});
+        m_capacity = 0U;
+    }
+
+    void deinit()
+    {
+        for (auto &buffer : m_buffers)
+            if (buffer.buffer != VK_NULL_HANDLE)
+                m_allocator->destroy(buffer);
+        m_buffers.clear();
+        m_ranges.deinit();
+        m_allocations.clear();
+        m_retired.clear();
+        m_capacity = m_used = 0U;
+    }
+
+    // false when no free range is large enough, grow first
+    bool allocate(uint32_t count, uint32_t &offset)
+    {
+        uint32_t aligned, size;
+        if (count == 0U || m_capacity == 0U || !m_ranges.subAllocate(count, 1U, offset, aligned, size))
+            return false;
+        m_allocations[offset] = size;
+        m_used += size;
+        return true;
+    }
+
+    // the range stays reserved until every frame in pendingFrames (bit per swapchain image) has been released
+    void free(uint32_t offset, uint32_t pendingFrames)
+    {
+        if (m_allocations.find(offset) == m_allocations.end())
+            return;
+        if (pendingFrames == 0U)
+            release(offset);
+        else
+            m_retired.push_back({offset, pendingFrames});
+    }
+
+    // the frame's previous submission has completed
+    void releaseFrame(uint32_t frameIndex)
+    {
+        for (auto &retired : m_retired)
+        {
+            retired.pendingFrames &= ~(1U << frameIndex);
+            if (retired.pendingFrames == 0U)
+                release(retired.offset);
+        }
+        std::erase_if(m_retired, [](const sRetiredRange &retired)
+                      { return retired.pendingFrames == 0U; });
+    }
+
+    // capacity becomes at least minCapacity elements, the replaced buffers are returned to be destroyed once cmdBuf has executed
+    // allocations keep their offsets: the new range allocator reserves the old capacity, then gives the unused parts back
+    std::vector<nvvk::Buffer> grow(VkCommandBuffer cmdBuf, uint32_t minCapacity)
+    {
+        auto capacity = std::max(m_capacity, kMinCapacity);
+        while (capacity < minCapacity)
+            capacity *= 2;
+        if (capacity == m_capacity)
+            return {};
+
+        std::vector<nvvk::Buffer> replaced{};
+        for (auto stream = 0U; stream < m_buffers.size(); ++stream)
+        {
+            auto buffer = m_allocator->createBuffer(static_cast<VkDeviceSize>(capacity) * m_elementSizes[stream], m_usage);
+            if (m_buffers[stream].buffer != VK_NULL_HANDLE)
+            {
+                const VkBufferCopy region{0, 0, static_cast<VkDeviceSize>(m_capacity) * m_elementSizes[stream]};
+                vkCmdCopyBuffer(cmdBuf, m_buffers[stream].buffer, buffer.buffer, 1, &region);
+                replaced.push_back(m_buffers[stream]);
+            }
+            m_buffers[stream] = buffer;
+        }
+
+        nvh::TRangeAllocator<1> ranges(capacity);
+        if (m_capacity > 0U)
+        {
+            uint32_t offset, aligned, size;
+            ranges.subAllocate(m_capacity, 1U, offset, aligned, size);
+            auto end = 0U;
+            for (const auto &[begin, count] : m_allocations)
+            {
+                if (begin > end)
+                    ranges.subFree(end, begin - end);
+                end = begin + count;
+            }
+            if (m_capacity > end)
+                ranges.subFree(end, m_capacity - end);
+        }
+        m_ranges = std::move(ranges);
+        m_capacity = capacity;
+        return replaced;
+    }
+
+    void upload(VkCommandBuffer cmdBuf, uint32_t stream, uint32_t offset, uint32_t count, const void *data)
+    {
+        if (count > 0U)
+            m_allocator->getStaging()->cmdToBuffer(cmdBuf, m_buffers[stream].buffer, static_cast<VkDeviceSize>(offset) * m_elementSizes[stream],
+                                                   static_cast<VkDeviceSize>(count) * m_elementSizes[stream], data);
+    }
+
+    const nvvk::Buffer &buffer(uint32_t stream) const { return m_buffers[stream]; }
+    VkDeviceSize elementSize(uint32_t stream) const { return m_elementSizes[stream]; }
+    uint32_t capacity() const { return m_capacity; }
+    uint32_t used() const { return m_used; }
+
+private:
+    static constexpr uint32_t kMinCapacity = 1U << 16;
+
+    struct sRetiredRange
+    {
+        uint32_t offset{};
+        uint32_t pendingFrames{};
+    };
+
+    void release(uint32_t offset)
+    {
+        const auto allocation = m_allocations.find(offset);
+        m_ranges.subFree(allocation->first, allocation->second);
+        m_used -= allocation->second;
+        m_allocations.erase(allocation);
+    }
+
+    nvvk::ResourceAllocator *m_allocator{nullptr};
+    std::vector<uint32_t> m_elementSizes{};
+    VkBufferUsageFlags m_usage{};
+    std::vector<nvvk::Buffer> m_buffers{};
+    nvh::TRangeAllocator<1> m_ranges{};
+    // live & retired ranges by offset, needed to rebuild the range allocator when growing
+    std::map<uint32_t, uint32_t> m_allocations{};
+    std::vector<sRetiredRange> m_retired{};
+    uint32_t m_capacity{0U};
+    uint32_t m_used{0U};
+};
\ No newline at end of file
@@ -0,0 +1,236 @@
+// images are decoded by the loader's own texture pool, tinygltf only has to keep them encoded
+#define TINYGLTF_IMPLEMENTATION
+#define TINYGLTF_NO_STB_IMAGE
+#define TINYGLTF_NO_STB_IMAGE_WRITE
+#define TINYGLTF_NO_EXTERNAL_IMAGE
+// tiny_gltf.h is only included through gltfscene.hpp, its implementation part has no include guard
+#include <nvh/gltfscene.hpp>
+
+#include <algorithm>
+#include <map>
+#include <tuple>
+
+#include <nvh/filemapping.hpp>
+
+#include "jobSystem.hpp"
+#include "modelLoader.h"
+
+namespace
+{
+    // keeps images encoded: embedded ones are read later straight from the model's buffers,
+    // only data URIs have no buffer to point into and are stored as-is
+    bool keepEncodedImage(tinygltf::Image *image, const int, std::string *, std::string *, int, int, const unsigned char *bytes, int size, void *)
+    {
+        if (image->bufferView < 0)
+        {
+            image->image.assign(bytes, bytes + size);
+            image->as_is = true;
+        }
+        return true;
+    }
+
+    // node transforms are baked into the vertices, instances of a mesh become separate meshes
+    void convertNode(const nvh::GltfScene &scene, const nvh::GltfNode &node, Mesh &mesh)
+    {
+        const auto &primMesh = scene.m_primMeshes[node.primMesh];
+        const auto normalMatrix = nvmath::transpose(nvmath::invert(node.worldMatrix));
+        // mirroring transforms turn the winding around
+        const auto mirrored = nvmath::det(node.worldMatrix) < 0.f;
+
+        mesh.name = primMesh.name;
+        mesh.vertices.resize(primMesh.vertexCount);
+        for (auto v = 0U; v < primMesh.vertexCount; ++v)
+        {
+            const auto &position = scene.m_positions[primMesh.vertexOffset + v];
+            const auto &normal = scene.m_normals[primMesh.vertexOffset + v];
+            const auto &uv = scene.m_texcoords0[primMesh.vertexOffset + v];
+            auto &vertex = mesh.vertices[v];
+            vertex.position = nvmath::vec3f(node.worldMatrix * nvmath::vec4f(position, 1.f));
+            vertex.normal = nvmath::normalize(nvmath::vec3f(normalMatrix * nvmath::vec4f(normal, 0.f)));
+            // textures are decoded flipped, same as for OBJ; the sampler repeats so uvs are kept unwrapped
+            vertex.uv = {uv.x, 1.f - uv.y};
+        }
+        mesh.bounding.minPoint = mesh.bounding.maxPoint = mesh.vertices.empty() ? nvmath::vec3f_zero : mesh.vertices.front().position;
+        for (const auto &vertex : mesh.vertices)
+            mesh.bounding.extend(vertex.position);
+
+        mesh.indices.assign(scene.m_indices.begin() + primMesh.firstIndex, scene.m_indices.begin() + primMesh.firstIndex + primMesh.indexCount);
+        mesh.faces.resize(mesh.indices.size() / 3);
+        for (auto f = 0ULL; f < mesh.faces.size(); ++f)
+        {
+            if (mirrored)
+                std::swap(mesh.indices[3 * f + 1], mesh.indices[3 * f + 2]);
+            mesh.faces[f].materialIndex = static_cast<uint32_t>(primMesh.materialIndex);
+            // assume triangle faces' front are CCW
+            auto vec1 = nvmath::normalize(mesh.vertices[mesh.indices[3 * f + 1]].position - mesh.vertices[mesh.indices[3 * f + 0]].position);
+            auto vec2 = nvmath::normalize(mesh.vertices[mesh.indices[3 * f + 2]].position - mesh.vertices[mesh.indices[3 * f + 1]].position);
+            mesh.faces[f].normal = nvmath::normalize(nvmath::cross(vec1, vec2));
+        }
+    }
+}
+
+bool ModelLoader::isGltf(const std::filesystem::path &filePath)
+{
+    auto extension = filePath.extension().generic_string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c)
+                   { return static_cast<char>(std::tolower(c)); });
+    return extension == ".gltf" || extension == ".glb";
+}
+
+void ModelLoader::loadGltf(std::vector<Mesh> &meshContainer, std::vector<Material> &matContainer, std::vector<Texture> &texContainer,
+                           const std::filesystem::path &filePath, const LoaderOptions &options, LoadingProgress *progress)
+{
+    if (progress)
+        progress->setStage("parsing " + filePath.filename().generic_string());
+
+    tinygltf::Model model{};
+    tinygltf::TinyGLTF parser{};
+    parser.SetImageLoader(keepEncodedImage, nullptr);
+    std::string error{}, warning{};
+    auto parsed = false;
+    {
+        // both flavours are parsed in place from the mapped file instead of being read into memory first
+        LoaderTimings::Scope scope(getTimings(progress), LoaderPhase::parse);
+        nvh::FileReadMapping mapping;
+        if (!mapping.open(filePath.generic_string().c_str()))
+            throw std::runtime_error("failed to open model [" + filePath.generic_string() + "].");
+        const auto data = static_cast<const unsigned char *>(mapping.data());
+        const auto size = static_cast<unsigned int>(mapping.size());
+        const auto baseDirectory = filePath.parent_path().generic_string();
+        if (size >= 4 && memcmp(data, "glTF", 4) == 0)
+            parsed = parser.LoadBinaryFromMemory(&model, &error, &warning, data, size, baseDirectory);
+        else
+            parsed = parser.LoadASCIIFromString(&model, &error, &warning, reinterpret_cast<const char *>(data), size, baseDirectory);
+    }
+    if (!warning.empty())
+        printf("WARNING: %s\n", warning.c_str());
+    if (!parsed)
+        throw std::runtime_error("failed to parse model [" + filePath.generic_string() + "]: " + error);
+    if (model.scenes.empty())
+        throw std::runtime_error("loaded model [" + filePath.generic_string() + "] contains no scene.");
+
+    if (progress && progress->cancelled())
+        return;
+
+    nvh::GltfScene scene{};
+    scene.importMaterials(model);
+    scene.importDrawableNodes(model, nvh::GltfAttributes::Normal | nvh::GltfAttributes::Texcoord_0,
+                              nvh::GltfAttributes::Normal | nvh::GltfAttributes::Texcoord_0);
+
+    // one texture per referenced image, whatever the number of samplers using it
+    std::vector<sTextureRef> textureRefs{};
+    // an image is shared by the textures converting it the same way
+    std::map<std::tuple<int, uint32_t, uint32_t>, uint32_t> imageMap{};
+    auto imageOf = [&](int textureIndex)
+    {
+        return textureIndex >= 0 && textureIndex < static_cast<int>(model.textures.size()) ? model.textures[textureIndex].source : -1;
+    };
+    auto acquireTexture = [&](int textureIndex, bool srgb, uint32_t keepMask = 0xFFFFFFFFU, uint32_t fillTexel = 0xFFFFFFFFU)
+    {
+        const auto imageIndex = imageOf(textureIndex);
+        if (imageIndex < 0 || imageIndex >= static_cast<int>(model.images.size()))
+            return 0x7FFFFFFFU;
+        const auto key = std::make_tuple(imageIndex, keepMask, fillTexel);
+        if (imageMap.find(key) == imageMap.end())
+        {
+            const auto &image = model.images[imageIndex];
+            sTextureRef ref{};
+            ref.srgb = srgb;
+            ref.keepMask = keepMask;
+            ref.fillTexel = fillTexel;
+            if (image.as_is)
+            {
+                ref.encoded = image.image.data();
+                ref.encodedSize = image.image.size();
+            }
+            else if (image.bufferView >= 0)
+            {
+                const auto &view = model.bufferViews[image.bufferView];
+                ref.encoded = model.buffers[view.buffer].data.data() + view.byteOffset;
+                ref.encodedSize = view.byteLength;
+            }
+            else
+                tinygltf::URIDecode(image.uri, &ref.name, nullptr);
+            if (ref.name.empty())
+                ref.name = image.name.empty() ? "image" + std::to_string(imageIndex) : image.name;
+            imageMap[key] = static_cast<uint32_t>(textureRefs.size());
+            textureRefs.emplace_back(std::move(ref));
+        }
+        return imageMap[key];
+    };
+    {
+        LoaderTimings::Scope scope(getTimings(progress), LoaderPhase::materials);
+        for (const auto &gltfMaterial : scene.m_materials)
+        {
+            Material temp{};
+            temp.name = gltfMaterial.tmaterial ? gltfMaterial.tmaterial->name : "default";
+            const auto baseColor = nvmath::vec3f(gltfMaterial.baseColorFactor);
+            temp.properties.diffuse = baseColor;
+            temp.properties.dissolve = gltfMaterial.baseColorFactor.w;
+            temp.properties.emission = gltfMaterial.emissiveFactor;
+            temp.properties.roughness = gltfMaterial.roughnessFactor;
+            temp.properties.metallic = gltfMaterial.metallicFactor;
+            temp.properties.ior = gltfMaterial.ior.ior;
+            temp.properties.illum = 2;
+            // the shading pass is Phong based: approximate the lobe with the usual roughness -> exponent mapping
+            const auto alpha = std::max(gltfMaterial.roughnessFactor * gltfMaterial.roughnessFactor, 1e-2f);
+            temp.properties.shininess = std::max(2.f / (alpha * alpha) - 2.f, 1.f);
+            temp.properties.specular = nvmath::lerp(gltfMaterial.metallicFactor, nvmath::vec3f(.04f), baseColor) * (1.f - gltfMaterial.roughnessFactor);
+
+            temp.properties.diffuse_map_index = acquireTexture(gltfMaterial.baseColorTexture, true);
+            temp.properties.normal_map_index = acquireTexture(gltfMaterial.normalTexture, false, 0xFFFFFFFFU, flatNormalTexel);
+            // converted to the basic PBR layout (R AO, G roughness, B metallic, A emission): G & B are glTF's already,
+            // R is the occlusion when both share an (ORM) image, A keeps the emissive factor as is
+            // a separate occlusion image is left out, nothing would sample it
+            if (gltfMaterial.metallicRoughnessTexture >= 0)
+            {
+                const auto packedOcclusion = imageOf(gltfMaterial.occlusionTexture) == imageOf(gltfMaterial.metallicRoughnessTexture);
+                temp.properties.basic_pbr_map_index = acquireTexture(gltfMaterial.metallicRoughnessTexture, false, packedOcclusion ? 0x00FFFFFFU : 0x00FFFF00U, 0xFF0000FFU);
+            }
+            matContainer.emplace_back(temp);
+        }
+    }
+
+    if (progress)
+    {
+        progress->addWork(static_cast<uint32_t>(1 + scene.m_nodes.size() + textureRefs.size()));
+        progress->advance();
+        progress->setStage("processing " + filePath.filename().generic_string());
+        if (progress->onMaterialsLoaded)
+            progress->onMaterialsLoaded(matContainer, textureRefs.size());
+    }
+
+    auto &jobSystem = JobSystem::getInstance();
+    auto textureDecoding = jobSystem.submit([&]()
+                                            { decodeTextures(textureRefs, texContainer, filePath.parent_path(), options, progress); });
+
+    meshContainer.resize(scene.m_nodes.size());
+    try
+    {
+        jobSystem.parallelFor<1>(scene.m_nodes.size(), [&](uint64_t nodeIndex)
+                                 {
+                                     if (progress && progress->cancelled())
+                                         return;
+                                     convertNode(scene, scene.m_nodes[nodeIndex], meshContainer[nodeIndex]);
+                                     postProcessMesh(meshContainer[nodeIndex], options, getTimings(progress));
+                                     if (progress)
+                                     {
+                                         progress->advance();
+                                         if (progress->onMeshLoaded)
+                                             progress->onMeshLoaded(static_cast<uint32_t>(nodeIndex), meshContainer[nodeIndex]);
+                                     } });
+    }
+    catch (...)
+    {
+        // the decoding job reads the model's buffers, it has to be finished before unwinding
+        try
+        {
+            jobSystem.wait(textureDecoding);
+        }
+        catch (...)
+        {
+        }
+        throw;
+    }
+    jobSystem.wait(textureDecoding);
+}
\ No newline at end of file
@@ -0,0 +1,349 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+class JobSystem;
+
+/* a unit of work submitted to the JobSystem */
+class Job
+{
+public:
+    bool finished() const { return m_finished.load(std::memory_order_acquire); }
+
+private:
+    friend class JobSystem;
+
+    std::function<void()> m_function;
+    // one extra reference is held by submit() until all dependencies are registered
+    std::atomic_uint32_t m_pendingDependencies{1U};
+    std::atomic_bool m_finished{false};
+    std::exception_ptr m_exception;
+    std::mutex m_mutex;
+    std::vector<std::shared_ptr<Job>> m_dependents;
+};
+
+using JobHandle = std::shared_ptr<Job>;
+
+/* process-wide pool of persistent worker threads with per-worker deques and work stealing */
+// workers push and pop their own jobs at the back (most recent first, cache friendly), idle workers steal the oldest jobs
+// from the front of the other deques; jobs submitted from outside the pool go into a shared queue.
+// a job is queued once all its dependencies finished (whether they succeeded or threw), a thread waiting for a job
+// executes queued jobs meanwhile, so jobs can submit and wait for other jobs without exhausting the pool
+class JobSystem
+{
+public:
+    JobSystem(const JobSystem &) = delete;
+    JobSystem &operator=(const JobSystem &) = delete;
+
+    // the pool is created on first use, with one worker less than the hardware threads (but at least one)
+    // as threads waiting for jobs execute them as well
+    static JobSystem &getInstance()
+    {
+        static JobSystem jobSystem(std::max(1U, std::thread::hardware_concurrency()) - 1);
+        return jobSystem;
+    }
+
+    // number of threads that can work concurrently, including the calling thread
+    uint32_t getConcurrency() const { return static_cast<uint32_t>(m_workers.size()) + 1; }
+
+    // the job is queued once all dependencies have finished
+    JobHandle submit(std::function<void()> fn, std::initializer_list<JobHandle> dependencies = {})
+    {
+        auto job = std::make_shared<Job>();
+        job->m_function = std::move(fn);
+        for (const auto &dependency : dependencies)
+        {
+            if (!dependency)
+                continue;
+            std::lock_guard<std::mutex> lock(dependency->m_mutex);
+            if (!dependency->finished())
+            {
+                job->m_pendingDependencies++;
+                dependency->m_dependents.emplace_back(job);
+            }
+        }
+        if (--job->m_pendingDependencies == 0)
+            enqueue(job);
+        return job;
+    }
+
+    // executes queued jobs until the job has finished, sleeps while nothing is runnable, rethrows its exception
+    void wait(const JobHandle &job)
+    {
+        while (!job->finished())
+        {
+            if (runPending())
+                continue;
+
+            std::unique_lock<std::mutex> lock(m_sleepMutex);
+            m_waiters++;
+            m_sleepCondition.wait(lock, [&]()
+                                  { return job->m_finished.load() || m_queued.load() > 0; });
+            m_waiters--;
+        }
+        if (job->m_exception)
+            std::rethrow_exception(job->m_exception);
+    }
+
+    // runs one queued job if there is one, returns false otherwise
+    bool runPending()
+    {
+        auto job = acquire();
+        if (!job)
+            return false;
+        execute(job);
+        return true;
+    }
+
+    // fn(itemIndex) or fn(itemIndex, threadIdx) for every item, batches of BATCHSIZE items
+    // are distributed over at most numThreads lanes (0 for all), threadIdx is the lane index
+    template <uint64_t BATCHSIZE = 128, typename Fn>
+    void parallelFor(uint64_t numItems, Fn &&fn, uint32_t numThreads = 0)
+    {
+        parallelRanges<BATCHSIZE>(numItems, [&](uint64_t itemBegin, uint64_t itemEnd, uint32_t threadIdx)
+                                  {
+                                      for (auto itemIdx = itemBegin; itemIdx < itemEnd; ++itemIdx)
+                                      {
+                                          if constexpr (std::is_invocable_v<Fn &, uint64_t, uint32_t>)
+                                              fn(itemIdx, threadIdx);
+                                          else
+                                              fn(itemIdx);
+                                      } }, numThreads);
+    }
+
+    // fn(itemBegin, itemEnd, threadIdx) for every batch of BATCHSIZE items, the calling thread is lane 0
+    template <uint64_t BATCHSIZE = 128, typename Fn>
+    void parallelRanges(uint64_t numItems, Fn &&fn, uint32_t numThreads = 0)
+    {
+        const auto numBatches = (numItems + BATCHSIZE - 1) / BATCHSIZE;
+        const auto numLanes = static_cast<uint32_t>(std::min<uint64_t>(numThreads ? numThreads : getConcurrency(), numBatches));
+        if (numLanes <= 1)
+        {
+            if (numItems)
+                fn(uint64_t{0}, numItems, uint32_t{0});
+            return;
+        }
+
+        std::atomic_uint64_t counter{0ULL};
+        auto lane = [&](uint32_t threadIdx)
+        {
+            uint64_t itemBegin;
+            while ((itemBegin = counter.fetch_add(BATCHSIZE)) < numItems)
+                fn(itemBegin, std::min(numItems, itemBegin + BATCHSIZE), threadIdx);
+        };
+
+        // lanes that never got scheduled find no work left, so the loop finishes as fast as the pool allows
+        std::vector<JobHandle> jobs(numLanes - 1);
+        for (auto i = 1U; i < numLanes; ++i)
+            jobs[i - 1] = submit([&lane, i]()
+                                 { lane(i); });
+        std::exception_ptr exception;
+        try
+        {
+            lane(0);
+        }
+        catch (...)
+        {
+            exception = std::current_exception();
+            counter = numItems;
+        }
+        for (const auto &job : jobs)
+        {
+            try
+            {
+                wait(job);
+            }
+            catch (...)
+            {
+                if (!exception)
+                    exception = std::current_exception();
+            }
+        }
+        if (exception)
+            std::rethrow_exception(exception);
+    }
+
+private:
+    struct sWorker
+    {
+        std::thread thread;
+        std::mutex mutex;
+        std::deque<JobHandle> jobs;
+    };
+
+    explicit JobSystem(uint32_t numWorkers)
+    {
+        numWorkers = std::max(1U, numWorkers);
+        // all workers must exist before any of them starts stealing
+        for (auto i = 0U; i < numWorkers; ++i)
+            m_workers.emplace_back(std::make_unique<sWorker>());
+        for (auto i = 0U; i < numWorkers; ++i)
+            m_workers[i]->thread = std::thread(&JobSystem::workerMain, this, i);
+    }
+
+    ~JobSystem()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_sleepMutex);
+            m_stop = true;
+        }
+        m_sleepCondition.notify_all();
+        for (auto &worker : m_workers)
+            worker->thread.join();
+    }
+
+    // index of the pool worker running on this thread, -1 for all other threads
+    static int32_t &workerIndex()
+    {
+        static thread_local int32_t index = -1;
+        return index;
+    }
+
+    void enqueue(JobHandle job)
+    {
+        const auto workerIdx = workerIndex();
+        if (workerIdx >= 0)
+        {
+            auto &worker = *m_workers[workerIdx];
+            std::lock_guard<std::mutex> lock(worker.mutex);
+            worker.jobs.emplace_back(std::move(job));
+        }
+        else
+        {
+            std::lock_guard<std::mutex> lock(m_sharedMutex);
+            m_sharedJobs.emplace_back(std::move(job));
+        }
+
+        m_queued++;
+        // taking the lock orders the notification after a sleeping worker checked m_queued
+        {
+            std::lock_guard<std::mutex> lock(m_sleepMutex);
+        }
+        m_sleepCondition.notify_one();
+    }
+
+    JobHandle acquire()
+    {
+        if (m_queued.load(std::memory_order_relaxed) == 0)
+            return nullptr;
+
+        JobHandle job;
+        const auto workerIdx = workerIndex();
+        const auto numWorkers = static_cast<uint32_t>(m_workers.size());
+        auto firstVictim = 0U;
+
+        // own jobs first, newest first as their data is most likely still cached
+        if (workerIdx >= 0)
+        {
+            auto &worker = *m_workers[workerIdx];
+            std::lock_guard<std::mutex> lock(worker.mutex);
+            if (!worker.jobs.empty())
+            {
+                job = std::move(worker.jobs.back());
+                worker.jobs.pop_back();
+            }
+            firstVictim = static_cast<uint32_t>(workerIdx) + 1;
+        }
+
+        if (!job)
+        {
+            std::lock_guard<std::mutex> lock(m_sharedMutex);
+            if (!m_sharedJobs.empty())
+            {
+                job = std::move(m_sharedJobs.front());
+                m_sharedJobs.pop_front();
+            }
+        }
+
+        // steal the oldest job of another worker, these tend to be the largest pieces of work
+        for (auto i = 0U; i < numWorkers && !job; ++i)
+        {
+            auto &victim = *m_workers[(firstVictim + i) % numWorkers];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.jobs.empty())
+            {
+                job = std::move(victim.jobs.front());
+                victim.jobs.pop_front();
+            }
+        }
+
+        if (job)
+            m_queued--;
+        return job;
+    }
+
+    void execute(const JobHandle &job)
+    {
+        try
+        {
+            job->m_function();
+        }
+        catch (...)
+        {
+            job->m_exception = std::current_exception();
+        }
+        // release the captures right away, waiters may hold on to the handle for longer
+        job->m_function = nullptr;
+
+        std::vector<JobHandle> dependents;
+        {
+            std::lock_guard<std::mutex> lock(job->m_mutex);
+            job->m_finished.store(true);
+            dependents.swap(job->m_dependents);
+        }
+        // both sides are sequentially consistent: either the waiter sees the job finished or its registration is seen here
+        if (m_waiters.load() > 0)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_sleepMutex);
+            }
+            m_sleepCondition.notify_all();
+        }
+        for (auto &dependent : dependents)
+        {
+            if (--dependent->m_pendingDependencies == 0)
+                enqueue(std::move(dependent));
+        }
+    }
+
+    void workerMain(uint32_t workerIdx)
+    {
+        workerIndex() = static_cast<int32_t>(workerIdx);
+        while (true)
+        {
+            if (runPending())
+                continue;
+
+            std::unique_lock<std::mutex> lock(m_sleepMutex);
+            m_sleepCondition.wait(lock, [&]()
+                                  { return m_stop || m_queued.load() > 0; });
+            // remaining jobs are drained before shutting down
+            if (m_stop && m_queued.load() == 0)
+                return;
+        }
+    }
+
+    std::vector<std::unique_ptr<sWorker>> m_workers;
+    std::mutex m_sharedMutex;
+    std::deque<JobHandle> m_sharedJobs;
+
+    // sleeping workers are woken whenever m_queued becomes non-zero,
+    // threads blocked in wait() also whenever a job finishes
+    std::atomic_uint64_t m_queued{0ULL};
+    std::atomic_uint32_t m_waiters{0U};
+    std::mutex m_sleepMutex;
+    std::condition_variable m_sleepCondition;
+    bool m_stop{false};
+};
\ No newline at end of file
@@ -123,6 +123,7 @@ int main(int argc, char **argv)
 
             vkCmdEndRenderPass(cmdBuffer);
         }
+        app.finishFrame(cmdBuffer);
 
         profiler.endFrame();
 
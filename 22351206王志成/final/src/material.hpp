@@ -32,6 +32,7 @@ struct alignas(16) MaterialAttribute
     float clearcoat_roughness = 0.0f; // Pcr
     float anisotropy = 0.0f;          // aniso
     float anisotropy_rotation = 0.0f; // anisor
+    // R: ambient occlusion, G: roughness, B: metallic, A: emission; scales roughness, metallic & emission
     uint32_t basic_pbr_map_index = {0x7FFFFFFF};
     uint32_t extra_pbr_map_index = {0x7FFFFFFF};
 };
@@ -42,4 +43,14 @@ struct Material
 
     /* simple parameters */
     MaterialAttribute properties{};
+
+    // texture indices are relative to the owning model until it is merged into a scene
+    void offsetTextureIndices(uint32_t offset)
+    {
+        for (auto index : {&properties.ambient_map_index, &properties.diffuse_map_index, &properties.specular_map_index,
+                           &properties.normal_map_index, &properties.displacement_map_index, &properties.reflection_map_index,
+                           &properties.basic_pbr_map_index, &properties.extra_pbr_map_index})
+            if (*index != 0x7FFFFFFF)
+                *index += offset;
+    }
 };
\ No newline at end of file
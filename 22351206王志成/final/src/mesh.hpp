@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <string>
 #include <vector>
 
@@ -7,6 +8,7 @@
 
 #include "utils.hpp"
 #include "boundingBox.hpp"
+#include "quantization.hpp"
 
 /* basic primitive attributes */
 struct alignas(16) VertexAttribute
@@ -21,12 +23,99 @@ struct alignas(16) VertexAttribute
     }
 };
 
+/* compact vertex, 16 bytes instead of 48 */
+// position: 16-bit unorm relative to the owning mesh's bounding box, boundsIndex selects that box on the GPU
+// normal: octahedral encoded, 2 x 16-bit snorm
+// uv: 2 x half float
+struct alignas(16) QuantizedVertex
+{
+    uint16_t position[3]{};
+    uint16_t boundsIndex{};
+    int16_t normal[2]{};
+    uint16_t uv[2]{};
+};
+
+// dequantization of one mesh: position = minPoint + quantized * scale
+struct alignas(16) VertexBounds
+{
+    nvmath::vec4f minPoint{nvmath::vec4f_zero};
+    nvmath::vec4f scale{nvmath::vec4f_zero};
+};
+
 struct alignas(16) FaceAttribute
 {
     nvmath::vec3 normal{nvmath::vec3f_zero};
     uint32_t materialIndex{0x7FFFFFFF};
 };
 
+/* one placed mesh, meshes of repeated objects are stored once and referenced by several instances */
+struct alignas(16) InstanceAttribute
+{
+    nvmath::mat4f transform{nvmath::mat4f_id};
+    // inverse transpose of transform, for the normals
+    nvmath::mat4f normalTransform{nvmath::mat4f_id};
+    // the mesh's triangles (all levels) in the triangle buffers
+    uint32_t firstTriangle{0U};
+    uint32_t triangleCount{0U};
+    // the mesh's MeshAttribute
+    uint32_t meshIndex{0U};
+    // the visibility flag of the row's first meshlet, its other meshlets follow
+    uint32_t firstMeshletVisibility{0U};
+};
+
+/* cluster of neighbouring triangles, the unit of fine-grained culling & streaming */
+// a meshlet is a contiguous triangle range of its mesh, so it can be drawn straight from the index buffer
+constexpr uint32_t kMaxMeshletVertices = 64U;
+constexpr uint32_t kMaxMeshletTriangles = 124U;
+struct alignas(16) Meshlet
+{
+    // xyz: center, w: radius
+    nvmath::vec4f boundingSphere{nvmath::vec4f_zero};
+    // xyz: average normal, w: sine of the cone's half angle (1 when the normals spread over a hemisphere or more)
+    // all triangles face away from a camera at c when dot(center - c, axis) >= w * length(center - c) + radius
+    nvmath::vec4f normalCone{0.f, 0.f, 0.f, 1.f};
+    uint32_t firstTriangle{0U};
+    uint32_t triangleCount{0U};
+    uint32_t vertexCount{0U};
+    uint32_t _{0U};
+};
+
+/* simplified level of a mesh, its triangles index the mesh's own vertices */
+constexpr uint32_t kMaxMeshLods = 4U;
+
+/* what the culling pass needs of a mesh: its bounds & the index ranges of its levels, level 0 is the full resolution mesh */
+struct alignas(16) MeshAttribute
+{
+    // object space bounding box, w unused
+    nvmath::vec4f boundingMin{nvmath::vec4f_zero};
+    nvmath::vec4f boundingMax{nvmath::vec4f_zero};
+    uint32_t levelCount{0U};
+    uint32_t firstIndex[kMaxMeshLods + 1]{};
+    uint32_t indexCount[kMaxMeshLods + 1]{};
+    // object space error of each level
+    float error[kMaxMeshLods + 1]{};
+    // the meshlets of level 0 in the meshlet buffer, 0 when the mesh has none
+    uint32_t firstMeshlet{0U};
+    uint32_t meshletCount{0U};
+    uint32_t _[2]{};
+};
+
+/* written by the culling pass, consumed by vkCmdDrawIndexedIndirectCount with this stride */
+struct alignas(16) DrawCommand
+{
+    VkDrawIndexedIndirectCommand command{};
+    // first triangle of the draw in the triangle buffers, read by the visibility pass through gl_DrawIDARB
+    uint32_t firstTriangle{0U};
+    uint32_t _[2]{};
+};
+struct MeshLod
+{
+    std::vector<uint32_t> indices;
+    std::vector<FaceAttribute> faces;
+    // object space distance the simplified surface may deviate from the full resolution one
+    float error{0.f};
+};
+
 namespace std
 {
     template <>
@@ -51,4 +140,67 @@ struct Mesh
     std::vector<uint32_t> indices;
     std::vector<FaceAttribute> faces;
     BoundingBox bounding;
+    // optional GPU layout of vertices, filled by quantize()
+    std::vector<QuantizedVertex> quantizedVertices;
+    // optional clusters covering all triangles in order, filled by buildMeshlets()
+    std::vector<Meshlet> meshlets;
+    // optional coarser levels with increasing error, filled by buildLods()
+    std::vector<MeshLod> lods;
+    // vertex cache statistics before & after optimizing (LoaderOptions::optimizeMeshes), 0 when not optimized
+    std::array<float, 2> acmr{};
+    std::array<float, 2> atvr{};
+
+    bool quantized() const { return quantizedVertices.size() == vertices.size(); }
+    VertexBounds getVertexBounds() const
+    {
+        const auto extent = bounding.maxPoint - bounding.minPoint;
+        return {nvmath::vec4f(bounding.minPoint, 0.f), nvmath::vec4f(extent / 65535.f, 0.f)};
+    }
+
+    // encodes vertices relative to bounding, which has to be up to date
+    void quantize()
+    {
+        const auto extent = bounding.maxPoint - bounding.minPoint;
+        auto relative = [](float value, float minValue, float extent)
+        { return extent > 0.f ? (value - minValue) / extent : 0.f; };
+
+        quantizedVertices.resize(vertices.size());
+        for (auto v = 0ULL; v < vertices.size(); ++v)
+        {
+            const auto &vertex = vertices[v];
+            auto &quantized = quantizedVertices[v];
+            for (auto i = 0; i < 3; ++i)
+                quantized.position[i] = packUnorm16(relative(vertex.position[i], bounding.minPoint[i], extent[i]));
+            const auto normal = encodeOctahedral(vertex.normal);
+            quantized.normal[0] = packSnorm16(normal.x);
+            quantized.normal[1] = packSnorm16(normal.y);
+            quantized.uv[0] = packHalf(vertex.uv.x);
+            quantized.uv[1] = packHalf(vertex.uv.y);
+        }
+    }
+
+    // order[i] is the source triangle moved to i, faces follow their triangle; meshlets have to be rebuilt afterwards
+    void reorderTriangles(const std::vector<uint32_t> &order)
+    {
+        std::vector<uint32_t> reorderedIndices(indices.size());
+        std::vector<FaceAttribute> reorderedFaces(faces.size());
+        for (auto t = 0ULL; t < order.size(); ++t)
+        {
+            const auto source = order[t];
+            for (auto i = 0; i < 3; ++i)
+                reorderedIndices[3 * t + i] = indices[3 * source + i];
+            reorderedFaces[t] = faces[source];
+        }
+        indices = std::move(reorderedIndices);
+        faces = std::move(reorderedFaces);
+        meshlets.clear();
+    }
+
+    // material indices are relative to the owning model until it is merged into a scene
+    void offsetMaterialIndices(uint32_t offset)
+    {
+        for (auto &face : faces)
+            if (face.materialIndex != 0x7FFFFFFF)
+                face.materialIndex += offset;
+    }
 };
\ No newline at end of file
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "mesh.hpp"
+
+/* post-load reordering of a welded mesh for the GPU's post-transform cache and vertex fetches */
+//   1. triangles are reordered with Forsyth's linear-speed vertex cache optimization, faces follow their triangle
+//   2. vertices are renumbered in order of first use, so fetches walk the vertex buffer mostly linearly
+// both passes only permute data, the rendered result is unchanged
+namespace MeshOptimizer
+{
+    // cache size the scores are tuned for, larger than any real FIFO so the order degrades gracefully on smaller ones
+    constexpr uint32_t kOptimizedCacheSize = 32U;
+    // FIFO size used for the statistics, roughly what current hardware reuses per batch
+    constexpr uint32_t kSimulatedCacheSize = 16U;
+
+    // ACMR: transformed vertices per triangle, 0.5 is ideal for a large regular grid, 3 means no reuse at all
+    // ATVR: transformed vertices per vertex, 1 is ideal
+    struct sCacheStatistics
+    {
+        float acmr{0.f};
+        float atvr{0.f};
+    };
+
+    inline sCacheStatistics analyzeVertexCache(const std::vector<uint32_t> &indices, size_t vertexCount, uint32_t cacheSize = kSimulatedCacheSize)
+    {
+        if (indices.empty() || vertexCount == 0)
+            return {};
+
+        // a vertex is in the FIFO while fewer than cacheSize misses happened since it was inserted
+        std::vector<uint32_t> insertedAt(vertexCount, 0U);
+        auto misses = 0U;
+        for (const auto index : indices)
+            if (insertedAt[index] == 0U || misses - insertedAt[index] + 1 > cacheSize)
+                insertedAt[index] = ++misses;
+        return {static_cast<float>(misses) / static_cast<float>(indices.size() / 3), static_cast<float>(misses) / static_cast<float>(vertexCount)};
+    }
+
+    // returns the triangle order, emitted[i] is the source triangle drawn i-th
+    inline std::vector<uint32_t> optimizeVertexCache(const std::vector<uint32_t> &indices, size_t vertexCount)
+    {
+        const auto triangleCount = indices.size() / 3;
+        std::vector<uint32_t> emitted{};
+        emitted.reserve(triangleCount);
+        if (triangleCount == 0)
+            return emitted;
+
+        // score of a vertex from its cache position (-1 when outside) and the number of triangles still using it;
+        // both terms are tabulated, the valence boost saturates as it hardly changes past a few dozen triangles
+        constexpr uint32_t kMaxValence = 64U;
+        float cacheScores[kOptimizedCacheSize + 3]{}, valenceScores[kMaxValence + 1]{};
+        for (auto i = 0U; i < kOptimizedCacheSize + 3; ++i)
+            // the last triangle's vertices get a fixed score so the next one does not simply reuse all three
+            cacheScores[i] = i < 3 ? .75f : (i < kOptimizedCacheSize ? std::pow(1.f - static_cast<float>(i - 3) / (kOptimizedCacheSize - 3), 1.5f) : 0.f);
+        for (auto i = 1U; i <= kMaxValence; ++i)
+            valenceScores[i] = 2.f / std::sqrt(static_cast<float>(i));
+        auto scoreVertex = [&](int32_t cachePosition, uint32_t remaining)
+        {
+            if (remaining == 0)
+                return -1.f;
+            return (cachePosition >= 0 ? cacheScores[cachePosition] : 0.f) + valenceScores[std::min(remaining, kMaxValence)];
+        };
+
+        // CSR vertex -> triangles, the live triangles of vertex v are triangles[offsets[v], offsets[v] + remaining[v])
+        std::vector<uint32_t> offsets(vertexCount + 1, 0U), remaining(vertexCount, 0U);
+        for (const auto index : indices)
+            ++remaining[index];
+        for (auto v = 0ULL; v < vertexCount; ++v)
+            offsets[v + 1] = offsets[v] + remaining[v];
+        std::vector<uint32_t> triangles(indices.size());
+        {
+            std::vector<uint32_t> cursors(offsets.begin(), offsets.end() - 1);
+            for (auto c = 0ULL; c < indices.size(); ++c)
+                triangles[cursors[indices[c]]++] = static_cast<uint32_t>(c / 3);
+        }
+
+        std::vector<int32_t> cachePositions(vertexCount, -1);
+        std::vector<float> vertexScores(vertexCount);
+        for (auto v = 0ULL; v < vertexCount; ++v)
+            vertexScores[v] = scoreVertex(-1, remaining[v]);
+        std::vector<bool> triangleEmitted(triangleCount, false);
+
+        // the cache briefly holds the new triangle's vertices on top of its nominal size
+        std::vector<uint32_t> cache{}, nextCache{};
+        cache.reserve(kOptimizedCacheSize + 3);
+        nextCache.reserve(kOptimizedCacheSize + 3);
+        auto bestTriangle = -1LL;
+        auto scanCursor = 0ULL;
+        while (emitted.size() < triangleCount)
+        {
+            // nothing in the cache is usable: restart from the next triangle in the source order,
+            // which keeps the pass linear and is where the locality of the OBJ/glTF order is left
+            if (bestTriangle < 0)
+            {
+                while (triangleEmitted[scanCursor])
+                    ++scanCursor;
+                bestTriangle = static_cast<int64_t>(scanCursor);
+            }
+
+            const auto triangle = static_cast<uint32_t>(bestTriangle);
+            emitted.emplace_back(triangle);
+            triangleEmitted[triangle] = true;
+
+            nextCache.clear();
+            for (auto i = 0; i < 3; ++i)
+            {
+                const auto vertex = indices[3 * triangle + i];
+                // drop the triangle from the vertex' live list
+                const auto live = triangles.begin() + offsets[vertex];
+                std::iter_swap(std::find(live, live + remaining[vertex], triangle), live + remaining[vertex] - 1);
+                --remaining[vertex];
+                nextCache.emplace_back(vertex);
+            }
+            for (const auto vertex : cache)
+                if (vertex != nextCache[0] && vertex != nextCache[1] && vertex != nextCache[2])
+                    nextCache.emplace_back(vertex);
+            std::swap(cache, nextCache);
+
+            // vertices pushed out of the cache only keep their valence score
+            for (auto i = 0U; i < cache.size(); ++i)
+                cachePositions[cache[i]] = i < kOptimizedCacheSize ? static_cast<int32_t>(i) : -1;
+            for (const auto vertex : cache)
+                vertexScores[vertex] = scoreVertex(cachePositions[vertex], remaining[vertex]);
+            if (cache.size() > kOptimizedCacheSize)
+                cache.resize(kOptimizedCacheSize);
+
+            // only triangles touching the cache changed their score, the next one is the best among them
+            bestTriangle = -1;
+            auto bestScore = -1.f;
+            for (const auto vertex : cache)
+                for (auto i = offsets[vertex]; i < offsets[vertex] + remaining[vertex]; ++i)
+                {
+                    const auto t = triangles[i];
+                    const auto score = vertexScores[indices[3 * t + 0]] + vertexScores[indices[3 * t + 1]] + vertexScores[indices[3 * t + 2]];
+                    if (score > bestScore)
+                    {
+                        bestScore = score;
+                        bestTriangle = t;
+                    }
+                }
+        }
+        return emitted;
+    }
+
+    inline void optimizeVertexCache(Mesh &mesh)
+    {
+        mesh.reorderTriangles(optimizeVertexCache(mesh.indices, mesh.vertices.size()));
+    }
+
+    // renumbers vertices by first use, triangles keep their order; unreferenced vertices are dropped
+    inline void optimizeVertexFetch(Mesh &mesh)
+    {
+        std::vector<uint32_t> remap(mesh.vertices.size(), ~0U);
+        std::vector<VertexAttribute> vertices{};
+        vertices.reserve(mesh.vertices.size());
+        for (auto &index : mesh.indices)
+        {
+            if (remap[index] == ~0U)
+            {
+                remap[index] = static_cast<uint32_t>(vertices.size());
+                vertices.emplace_back(mesh.vertices[index]);
+            }
+            index = remap[index];
+        }
+        if (mesh.quantized())
+        {
+            std::vector<QuantizedVertex> quantizedVertices(vertices.size());
+            for (auto v = 0ULL; v < remap.size(); ++v)
+                if (remap[v] != ~0U)
+                    quantizedVertices[remap[v]] = mesh.quantizedVertices[v];
+            mesh.quantizedVertices = std::move(quantizedVertices);
+        }
+        mesh.vertices = std::move(vertices);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,348 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+#include "mesh.hpp"
+#include "meshOptimizer.hpp"
+
+/* quadric error metric simplification producing a chain of LODs */
+// edges are collapsed onto one of their endpoints, so every level indexes the mesh's own vertices and
+// shares its vertex buffer. topology is built on welded positions, attribute seams (normal/uv splits) collapse like any
+// other vertex: a corner moved onto another position takes the vertex there with the closest normal & uv
+//   1. every position accumulates the area weighted plane quadrics of its triangles, plus perpendicular planes along
+//      borders and material boundaries so they are kept in place
+//   2. passes sort all edges by the error their cheapest collapse introduces and collapse them greedily, one collapse per
+//      neighbourhood per pass so the flip test stays valid
+//   3. a level is recorded every time the triangle count halves, until the error bound or kMaxMeshLods is reached
+namespace MeshSimplifier
+{
+    // fraction of the previous level's triangles each level aims for
+    constexpr float kLevelRatio = .5f;
+    // levels stop once the deviation exceeds this fraction of the mesh's bounding box diagonal
+    constexpr float kMaxRelativeError = .1f;
+
+    namespace detail
+    {
+        // symmetric 4x4 matrix of plane equations, evaluate() gives the weighted sum of squared distances to the planes
+        struct sQuadric
+        {
+            double a2{}, b2{}, c2{}, ab{}, ac{}, bc{}, ad{}, bd{}, cd{}, d2{};
+            double weight{};
+
+            static sQuadric fromPlane(const nvmath::vec3f &normal, float distance, double weight)
+            {
+                const double a = normal.x, b = normal.y, c = normal.z, d = distance;
+                return {a * a * weight, b * b * weight, c * c * weight, a * b * weight, a * c * weight, b * c * weight,
+                        a * d * weight, b * d * weight, c * d * weight, d * d * weight, weight};
+            }
+
+            sQuadric &operator+=(const sQuadric &other)
+            {
+                a2 += other.a2, b2 += other.b2, c2 += other.c2, ab += other.ab, ac += other.ac, bc += other.bc;
+                ad += other.ad, bd += other.bd, cd += other.cd, d2 += other.d2, weight += other.weight;
+                return *this;
+            }
+
+            double evaluate(const nvmath::vec3f &p) const
+            {
+                const double x = p.x, y = p.y, z = p.z;
+                const auto result = a2 * x * x + b2 * y * y + c2 * z * z + 2. * (ab * x * y + ac * x * z + bc * y * z + ad * x + bd * y + cd * z) + d2;
+                return std::max(result, 0.);
+            }
+        };
+
+        struct sCollapse
+        {
+            double cost{};
+            uint32_t from{};
+            uint32_t to{};
+        };
+    }
+
+    // appends up to kMaxMeshLods levels to mesh.lods, each with at most kLevelRatio of the previous level's triangles
+    inline void buildLods(Mesh &mesh)
+    {
+        mesh.lods.clear();
+        const auto triangleCount = mesh.indices.size() / 3;
+        if (triangleCount < 64)
+            return;
+
+        // weld positions, vertices at one position are listed in positionVertices[positionOffsets[p], positionOffsets[p + 1])
+        std::vector<uint32_t> positionOf(mesh.vertices.size());
+        std::vector<nvmath::vec3f> positions{};
+        {
+            std::unordered_map<nvmath::vec3, uint32_t> positionMap{};
+            positionMap.reserve(mesh.vertices.size());
+            for (auto v = 0ULL; v < mesh.vertices.size(); ++v)
+            {
+                const auto [iter, inserted] = positionMap.try_emplace(mesh.vertices[v].position, static_cast<uint32_t>(positions.size()));
+                if (inserted)
+                    positions.emplace_back(mesh.vertices[v].position);
+                positionOf[v] = iter->second;
+            }
+        }
+        const auto positionCount = static_cast<uint32_t>(positions.size());
+        std::vector<uint32_t> positionOffsets(positionCount + 1, 0U), positionVertices(mesh.vertices.size());
+        for (const auto p : positionOf)
+            ++positionOffsets[p + 1];
+        for (auto p = 0U; p < positionCount; ++p)
+            positionOffsets[p + 1] += positionOffsets[p];
+        {
+            std::vector<uint32_t> cursors(positionOffsets.begin(), positionOffsets.end() - 1);
+            for (auto v = 0U; v < static_cast<uint32_t>(mesh.vertices.size()); ++v)
+                positionVertices[cursors[positionOf[v]]++] = v;
+        }
+
+        // triangles over positions, corner i of triangle t still corresponds to corner i of its source triangle
+        std::vector<uint32_t> triangles{}, sources{};
+        triangles.reserve(mesh.indices.size());
+        sources.reserve(triangleCount);
+        for (auto t = 0U; t < static_cast<uint32_t>(triangleCount); ++t)
+        {
+            const auto p0 = positionOf[mesh.indices[3 * t + 0]], p1 = positionOf[mesh.indices[3 * t + 1]], p2 = positionOf[mesh.indices[3 * t + 2]];
+            if (p0 == p1 || p1 == p2 || p2 == p0)
+                continue;
+            triangles.insert(triangles.end(), {p0, p1, p2});
+            sources.emplace_back(t);
+        }
+        auto getMaterial = [&](size_t t)
+        { return mesh.faces[sources[t]].materialIndex; };
+        auto getNormal = [&](uint32_t p0, uint32_t p1, uint32_t p2)
+        { return nvmath::cross(positions[p1] - positions[p0], positions[p2] - positions[p0]); };
+        auto getSourceNormal = [&](size_t t)
+        {
+            const auto *corners = &mesh.indices[3 * sources[t]];
+            return getNormal(positionOf[corners[0]], positionOf[corners[1]], positionOf[corners[2]]);
+        };
+
+        std::vector<detail::sQuadric> quadrics(positionCount);
+        for (auto t = 0ULL; t < sources.size(); ++t)
+        {
+            const auto *corners = &triangles[3 * t];
+            auto normal = getNormal(corners[0], corners[1], corners[2]);
+            const auto length = nvmath::length(normal);
+            if (length == 0.f)
+                continue;
+            normal /= length;
+            const auto quadric = detail::sQuadric::fromPlane(normal, -nvmath::dot(normal, positions[corners[0]]), length * .5);
+            for (auto i = 0; i < 3; ++i)
+                quadrics[corners[i]] += quadric;
+        }
+        // edges used by a single triangle, or by triangles of different materials, get a plane through the edge
+        // perpendicular to the triangle: sliding along the boundary is free, leaving it is expensive
+        {
+            constexpr double boundaryWeight = 10.;
+            std::vector<std::pair<uint64_t, uint32_t>> edges{};
+            edges.reserve(triangles.size());
+            for (auto t = 0U; t < static_cast<uint32_t>(sources.size()); ++t)
+                for (auto i = 0; i < 3; ++i)
+                {
+                    const auto a = triangles[3 * t + i], b = triangles[3 * t + (i + 1) % 3];
+                    edges.push_back({(static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b), 3 * t + i});
+                }
+            std::sort(edges.begin(), edges.end());
+            for (auto begin = 0ULL; begin < edges.size();)
+            {
+                auto end = begin + 1;
+                auto sameMaterial = true;
+                for (; end < edges.size() && edges[end].first == edges[begin].first; ++end)
+                    sameMaterial &= getMaterial(edges[end].second / 3) == getMaterial(edges[begin].second / 3);
+                if (end - begin == 1 || !sameMaterial)
+                    for (auto e = begin; e < end; ++e)
+                    {
+                        const auto corner = edges[e].second;
+                        const auto t = corner / 3;
+                        const auto a = triangles[corner], b = triangles[3 * t + (corner + 1) % 3];
+                        const auto edge = positions[b] - positions[a];
+                        auto normal = nvmath::cross(edge, getNormal(triangles[3 * t + 0], triangles[3 * t + 1], triangles[3 * t + 2]));
+                        const auto length = nvmath::length(normal);
+                        if (length == 0.f)
+                            continue;
+                        normal /= length;
+                        const auto quadric = detail::sQuadric::fromPlane(normal, -nvmath::dot(normal, positions[a]), nvmath::dot(edge, edge) * boundaryWeight);
+                        quadrics[a] += quadric;
+                        quadrics[b] += quadric;
+                    }
+                begin = end;
+            }
+        }
+
+        const auto diagonal = nvmath::length(nvmath::vec3f(mesh.bounding.maxPoint - mesh.bounding.minPoint));
+        const auto maxCost = static_cast<double>(diagonal * kMaxRelativeError) * (diagonal * kMaxRelativeError);
+        auto collapseCost = [&](uint32_t from, uint32_t to)
+        {
+            auto merged = quadrics[from];
+            merged += quadrics[to];
+            return merged.weight > 0. ? merged.evaluate(positions[to]) / merged.weight : 0.;
+        };
+
+        std::vector<uint32_t> adjacencyOffsets(positionCount + 1), adjacency{};
+        std::vector<uint64_t> edgeKeys{};
+        std::vector<detail::sCollapse> collapses{};
+        std::vector<uint32_t> remap(positionCount);
+        std::vector<bool> locked(positionCount);
+        auto levelError = 0.;
+        auto previousCount = sources.size();
+        while (mesh.lods.size() < kMaxMeshLods)
+        {
+            const auto targetCount = static_cast<size_t>(previousCount * kLevelRatio);
+            auto stalled = false;
+            while (sources.size() > targetCount && !stalled)
+            {
+                // position -> triangles CSR of the current level
+                std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0U);
+                for (const auto p : triangles)
+                    ++adjacencyOffsets[p + 1];
+                for (auto p = 0U; p < positionCount; ++p)
+                    adjacencyOffsets[p + 1] += adjacencyOffsets[p];
+                adjacency.resize(triangles.size());
+                {
+                    std::vector<uint32_t> cursors(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+                    for (auto c = 0U; c < static_cast<uint32_t>(triangles.size()); ++c)
+                        adjacency[cursors[triangles[c]]++] = c / 3;
+                }
+
+                edgeKeys.clear();
+                for (auto t = 0ULL; t < sources.size(); ++t)
+                    for (auto i = 0; i < 3; ++i)
+                    {
+                        const auto a = triangles[3 * t + i], b = triangles[3 * t + (i + 1) % 3];
+                        edgeKeys.emplace_back((static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b));
+                    }
+                std::sort(edgeKeys.begin(), edgeKeys.end());
+                edgeKeys.erase(std::unique(edgeKeys.begin(), edgeKeys.end()), edgeKeys.end());
+                collapses.clear();
+                for (const auto key : edgeKeys)
+                {
+                    const auto a = static_cast<uint32_t>(key >> 32), b = static_cast<uint32_t>(key & 0xFFFFFFFFULL);
+                    const auto costAB = collapseCost(a, b), costBA = collapseCost(b, a);
+                    collapses.push_back(costAB <= costBA ? detail::sCollapse{costAB, a, b} : detail::sCollapse{costBA, b, a});
+                }
+                std::sort(collapses.begin(), collapses.end(), [](const detail::sCollapse &x, const detail::sCollapse &y)
+                          { return x.cost < y.cost; });
+
+                for (auto p = 0U; p < positionCount; ++p)
+                    remap[p] = p;
+                std::fill(locked.begin(), locked.end(), false);
+                auto remainingCount = sources.size();
+                auto collapsed = 0ULL;
+                for (const auto &collapse : collapses)
+                {
+                    if (remainingCount <= targetCount || collapse.cost > maxCost)
+                        break;
+                    if (locked[collapse.from] || locked[collapse.to])
+                        continue;
+
+                    // the triangles around from must not fold over once from moves onto to, nor turn away from the
+                    // full resolution triangle they stand for, which catches flips accumulated over several passes
+                    auto removed = 0U;
+                    auto flips = false;
+                    for (auto i = adjacencyOffsets[collapse.from]; i < adjacencyOffsets[collapse.from + 1] && !flips; ++i)
+                    {
+                        const auto *corners = &triangles[3 * adjacency[i]];
+                        if (corners[0] == collapse.to || corners[1] == collapse.to || corners[2] == collapse.to)
+                        {
+                            ++removed;
+                            continue;
+                        }
+                        uint32_t moved[3]{corners[0], corners[1], corners[2]};
+                        for (auto &p : moved)
+                            if (p == collapse.from)
+                                p = collapse.to;
+                        const auto before = getNormal(corners[0], corners[1], corners[2]);
+                        const auto after = getNormal(moved[0], moved[1], moved[2]);
+                        flips = nvmath::dot(before, after) <= .25f * nvmath::length(before) * nvmath::length(after) ||
+                                nvmath::dot(getSourceNormal(adjacency[i]), after) <= 0.f;
+                    }
+                    if (flips)
+                        continue;
+
+                    remap[collapse.from] = collapse.to;
+                    quadrics[collapse.to] += quadrics[collapse.from];
+                    levelError = std::max(levelError, collapse.cost);
+                    remainingCount -= removed;
+                    ++collapsed;
+                    // the whole neighbourhood of from changed, its flip tests are redone in the next pass
+                    for (auto i = adjacencyOffsets[collapse.from]; i < adjacencyOffsets[collapse.from + 1]; ++i)
+                        for (auto c = 0; c < 3; ++c)
+                            locked[triangles[3 * adjacency[i] + c]] = true;
+                    locked[collapse.to] = true;
+                }
+                stalled = collapsed == 0;
+
+                auto kept = 0ULL;
+                for (auto t = 0ULL; t < sources.size(); ++t)
+                {
+                    const auto p0 = remap[triangles[3 * t + 0]], p1 = remap[triangles[3 * t + 1]], p2 = remap[triangles[3 * t + 2]];
+                    if (p0 == p1 || p1 == p2 || p2 == p0)
+                        continue;
+                    triangles[3 * kept + 0] = p0;
+                    triangles[3 * kept + 1] = p1;
+                    triangles[3 * kept + 2] = p2;
+                    sources[kept++] = sources[t];
+                }
+                triangles.resize(3 * kept);
+                sources.resize(kept);
+            }
+
+            // a level has to save a meaningful amount of work to be worth its memory
+            if (sources.empty() || sources.size() > previousCount * .9f)
+                break;
+            previousCount = sources.size();
+
+            MeshLod lod{};
+            lod.error = static_cast<float>(std::sqrt(levelError));
+            lod.indices.resize(triangles.size());
+            for (auto c = 0ULL; c < triangles.size(); ++c)
+            {
+                const auto original = mesh.indices[3 * sources[c / 3] + c % 3];
+                const auto target = triangles[c];
+                if (positionOf[original] == target)
+                {
+                    lod.indices[c] = original;
+                    continue;
+                }
+                auto best = positionVertices[positionOffsets[target]];
+                auto bestDistance = std::numeric_limits<float>::max();
+                for (auto i = positionOffsets[target]; i < positionOffsets[target + 1]; ++i)
+                {
+                    const auto &candidate = mesh.vertices[positionVertices[i]];
+                    const auto normalDelta = nvmath::vec3f(candidate.normal - mesh.vertices[original].normal);
+                    const auto uvDelta = nvmath::vec2f(candidate.uv - mesh.vertices[original].uv);
+                    const auto distance = nvmath::dot(normalDelta, normalDelta) + nvmath::dot(uvDelta, uvDelta);
+                    if (distance < bestDistance)
+                    {
+                        best = positionVertices[i];
+                        bestDistance = distance;
+                    }
+                }
+                lod.indices[c] = best;
+            }
+            lod.faces.resize(sources.size());
+            for (auto t = 0ULL; t < sources.size(); ++t)
+            {
+                lod.faces[t].materialIndex = mesh.faces[sources[t]].materialIndex;
+                auto vec1 = nvmath::normalize(mesh.vertices[lod.indices[3 * t + 1]].position - mesh.vertices[lod.indices[3 * t + 0]].position);
+                auto vec2 = nvmath::normalize(mesh.vertices[lod.indices[3 * t + 2]].position - mesh.vertices[lod.indices[3 * t + 1]].position);
+                lod.faces[t].normal = nvmath::normalize(nvmath::cross(vec1, vec2));
+            }
+
+            const auto order = MeshOptimizer::optimizeVertexCache(lod.indices, mesh.vertices.size());
+            std::vector<uint32_t> indices(lod.indices.size());
+            std::vector<FaceAttribute> faces(lod.faces.size());
+            for (auto t = 0ULL; t < order.size(); ++t)
+            {
+                for (auto i = 0; i < 3; ++i)
+                    indices[3 * t + i] = lod.indices[3 * order[t] + i];
+                faces[t] = lod.faces[order[t]];
+            }
+            lod.indices = std::move(indices);
+            lod.faces = std::move(faces);
+            mesh.lods.emplace_back(std::move(lod));
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "mesh.hpp"
+
+/* greedy partition of a mesh into meshlets of at most kMaxMeshletVertices vertices / kMaxMeshletTriangles triangles */
+// a meshlet starts at the first unassigned triangle and grows over triangles sharing vertices with it,
+// preferring the ones adding the fewest new vertices, then the ones closest to its centroid (keeps it round)
+// triangles are reordered so every meshlet is a contiguous range, inside a meshlet they keep their relative order,
+// which preserves a previous vertex cache optimization
+namespace MeshletBuilder
+{
+    namespace detail
+    {
+        inline Meshlet computeBounds(const Mesh &mesh, uint32_t firstTriangle, uint32_t triangleCount, const uint32_t *vertices, uint32_t vertexCount)
+        {
+            Meshlet meshlet{};
+            meshlet.firstTriangle = firstTriangle;
+            meshlet.triangleCount = triangleCount;
+            meshlet.vertexCount = vertexCount;
+
+            BoundingBox box{};
+            box.minPoint = box.maxPoint = mesh.vertices[vertices[0]].position;
+            for (auto v = 0U; v < vertexCount; ++v)
+                box.extend(mesh.vertices[vertices[v]].position);
+            const nvmath::vec3f center = (box.minPoint + box.maxPoint) * .5f;
+            auto radius = 0.f;
+            for (auto v = 0U; v < vertexCount; ++v)
+                radius = std::max(radius, nvmath::length(nvmath::vec3f(mesh.vertices[vertices[v]].position) - center));
+            meshlet.boundingSphere = nvmath::vec4f(center, radius);
+
+            // degenerated faces have no usable normal and cannot be back faces either
+            auto isValid = [](const nvmath::vec3f &normal)
+            { return normal == normal && nvmath::dot(normal, normal) > .5f; };
+            auto axis = nvmath::vec3f_zero;
+            for (auto t = firstTriangle; t < firstTriangle + triangleCount; ++t)
+                if (isValid(mesh.faces[t].normal))
+                    axis += nvmath::vec3f(mesh.faces[t].normal);
+            const auto axisLength = nvmath::length(axis);
+            if (axisLength == 0.f)
+                return meshlet;
+            axis /= axisLength;
+            auto minDot = 1.f;
+            for (auto t = firstTriangle; t < firstTriangle + triangleCount; ++t)
+                if (isValid(mesh.faces[t].normal))
+                    minDot = std::min(minDot, nvmath::dot(axis, nvmath::vec3f(mesh.faces[t].normal)));
+            meshlet.normalCone = nvmath::vec4f(axis, minDot <= 0.f ? 1.f : std::sqrt(1.f - minDot * minDot));
+            return meshlet;
+        }
+    }
+
+    inline void buildMeshlets(Mesh &mesh)
+    {
+        const auto triangleCount = static_cast<uint32_t>(mesh.indices.size() / 3);
+        const auto vertexCount = mesh.vertices.size();
+        mesh.meshlets.clear();
+        if (triangleCount == 0)
+            return;
+
+        // CSR vertex -> triangles
+        std::vector<uint32_t> offsets(vertexCount + 1, 0U);
+        for (const auto index : mesh.indices)
+            ++offsets[index + 1];
+        for (auto v = 0ULL; v < vertexCount; ++v)
+            offsets[v + 1] += offsets[v];
+        std::vector<uint32_t> adjacency(mesh.indices.size());
+        {
+            std::vector<uint32_t> cursors(offsets.begin(), offsets.end() - 1);
+            for (auto c = 0ULL; c < mesh.indices.size(); ++c)
+                adjacency[cursors[mesh.indices[c]]++] = static_cast<uint32_t>(c / 3);
+        }
+
+        // stamps hold the index of the meshlet a vertex is part of / a triangle is a candidate of
+        std::vector<uint32_t> vertexStamps(vertexCount, ~0U), candidateStamps(triangleCount, ~0U);
+        std::vector<bool> assigned(triangleCount, false);
+        std::vector<uint32_t> order{}, candidates{}, localVertices{}, meshletVertices{};
+        std::vector<Meshlet> meshlets{};
+        order.reserve(triangleCount);
+        meshletVertices.reserve(vertexCount);
+        localVertices.reserve(kMaxMeshletVertices);
+        auto scanCursor = 0U;
+        while (order.size() < triangleCount)
+        {
+            const auto meshletIndex = static_cast<uint32_t>(meshlets.size());
+            const auto firstTriangle = static_cast<uint32_t>(order.size());
+            auto centroidSum = nvmath::vec3f_zero;
+            candidates.clear();
+            localVertices.clear();
+
+            auto countNewVertices = [&](uint32_t triangle)
+            {
+                const auto *corners = &mesh.indices[3 * triangle];
+                auto count = 0U;
+                for (auto i = 0; i < 3; ++i)
+                    if (vertexStamps[corners[i]] != meshletIndex && (i == 0 || corners[i] != corners[0]) && (i < 2 || corners[2] != corners[1]))
+                        ++count;
+                return count;
+            };
+            auto addTriangle = [&](uint32_t triangle)
+            {
+                assigned[triangle] = true;
+                order.emplace_back(triangle);
+                for (auto i = 0; i < 3; ++i)
+                {
+                    const auto vertex = mesh.indices[3 * triangle + i];
+                    if (vertexStamps[vertex] == meshletIndex)
+                        continue;
+                    vertexStamps[vertex] = meshletIndex;
+                    localVertices.emplace_back(vertex);
+                    centroidSum += nvmath::vec3f(mesh.vertices[vertex].position);
+                    for (auto a = offsets[vertex]; a < offsets[vertex + 1]; ++a)
+                        if (!assigned[adjacency[a]] && candidateStamps[adjacency[a]] != meshletIndex)
+                        {
+                            candidateStamps[adjacency[a]] = meshletIndex;
+                            candidates.emplace_back(adjacency[a]);
+                        }
+                }
+            };
+
+            while (assigned[scanCursor])
+                ++scanCursor;
+            addTriangle(scanCursor);
+            while (order.size() - firstTriangle < kMaxMeshletTriangles)
+            {
+                const auto centroid = centroidSum / static_cast<float>(localVertices.size());
+                auto best = ~0U, bestNewVertices = 4U;
+                auto bestDistance = std::numeric_limits<float>::max();
+                // assigned triangles are compacted out of the candidate list while searching
+                auto kept = 0ULL;
+                for (auto c = 0ULL; c < candidates.size(); ++c)
+                {
+                    const auto triangle = candidates[c];
+                    if (assigned[triangle])
+                        continue;
+                    candidates[kept++] = triangle;
+                    if (bestNewVertices == 0U)
+                        continue;
+                    const auto newVertices = countNewVertices(triangle);
+                    if (localVertices.size() + newVertices > kMaxMeshletVertices || newVertices > bestNewVertices)
+                        continue;
+                    const auto *corners = &mesh.indices[3 * triangle];
+                    const auto distance = nvmath::length(nvmath::vec3f(mesh.vertices[corners[0]].position + mesh.vertices[corners[1]].position + mesh.vertices[corners[2]].position) / 3.f - centroid);
+                    if (newVertices < bestNewVertices || distance < bestDistance)
+                    {
+                        best = triangle;
+                        bestNewVertices = newVertices;
+                        bestDistance = distance;
+                    }
+                }
+                candidates.resize(kept);
+                if (best == ~0U)
+                    break;
+                addTriangle(best);
+            }
+
+            std::sort(order.begin() + firstTriangle, order.end());
+            // bounds need the faces in their final place, they are computed once all triangles are assigned
+            meshlets.push_back({});
+            meshlets.back().firstTriangle = firstTriangle;
+            meshlets.back().triangleCount = static_cast<uint32_t>(order.size()) - firstTriangle;
+            meshlets.back().vertexCount = static_cast<uint32_t>(localVertices.size());
+            meshletVertices.insert(meshletVertices.end(), localVertices.begin(), localVertices.end());
+        }
+
+        mesh.reorderTriangles(order);
+        const auto *vertices = meshletVertices.data();
+        for (auto &meshlet : meshlets)
+        {
+            meshlet = detail::computeBounds(mesh, meshlet.firstTriangle, meshlet.triangleCount, vertices, meshlet.vertexCount);
+            vertices += meshlet.vertexCount;
+        }
+        mesh.meshlets = std::move(meshlets);
+    }
+}
\ No newline at end of file
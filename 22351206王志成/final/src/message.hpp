@@ -1,8 +1,15 @@
 #pragma once
 
+#include <mutex>
 #include <string>
 #include <vector>
 
+// windows.h defines MessageBox as a macro
+#ifdef MessageBox
+#undef MessageBox
+#endif
+
+/* on-screen log & progress, fed from any thread and drawn by the GUI */
 class MessageBox
 {
 public:
@@ -10,10 +17,53 @@ public:
     MessageBox(MessageBox&&) = delete;
     MessageBox& operator=(const MessageBox&) = delete;
     MessageBox& operator=(MessageBox&&) = delete;
+
+    static MessageBox &getInstance()
+    {
+        static MessageBox instance;
+        return instance;
+    }
+
+    void push(const std::string &message)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_messageLines.emplace_back(message);
+        if (m_messageLines.size() > maxMessageLines)
+            m_messageLines.erase(m_messageLines.begin());
+    }
+
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_messageLines.clear();
+    }
+
+    // negative progress hides the progress bar
+    void setProgress(float progress)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_progress = progress;
+    }
+
+    auto getMessages() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_messageLines;
+    }
+
+    auto getProgress() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_progress;
+    }
+
 private:
     MessageBox() {}
     ~MessageBox() {}
 
-    std::vector<std::string_view> m_messageLines{};
-    float m_progress{.0f};
+    static constexpr size_t maxMessageLines = 8;
+
+    mutable std::mutex m_mutex{};
+    std::vector<std::string> m_messageLines{};
+    float m_progress{-1.f};
 };
\ No newline at end of file
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+
+/* full mip chains for decoded RGBA8 textures, built on the CPU by the thread that decoded the texture */
+// every level is a 2x2 box filter of the previous one,
+// color textures are filtered in linear space and re-encoded to sRGB, alpha and data textures are averaged as stored
+namespace MipGenerator
+{
+    inline uint32_t mipLevelCount(uint32_t width, uint32_t height)
+    {
+        return static_cast<uint32_t>(std::bit_width(std::max({width, height, 1U})));
+    }
+
+    // bytes of levelCount RGBA8 levels stored one after another
+    inline size_t mipChainSize(uint32_t width, uint32_t height, uint32_t levelCount)
+    {
+        size_t size = 0ULL;
+        for (auto level = 0U; level < levelCount; ++level)
+            size += static_cast<size_t>(std::max(width >> level, 1U)) * std::max(height >> level, 1U) * 4;
+        return size;
+    }
+
+    namespace detail
+    {
+        // linear values are encoded through a 4096 entries table, fine enough to keep every 8 bit sRGB value reachable
+        constexpr uint32_t kEncodeTableSize = 4096U;
+
+        inline const float *srgbToLinearTable()
+        {
+            static const auto table = []()
+            {
+                std::array<float, 256> res{};
+                for (auto i = 0U; i < 256; ++i)
+                {
+                    const auto c = i / 255.f;
+                    res[i] = c <= .04045f ? c / 12.92f : std::pow((c + .055f) / 1.055f, 2.4f);
+                }
+                return res;
+            }();
+            return table.data();
+        }
+
+        inline const uint8_t *linearToSrgbTable()
+        {
+            static const auto table = []()
+            {
+                std::array<uint8_t, kEncodeTableSize> res{};
+                for (auto i = 0U; i < kEncodeTableSize; ++i)
+                {
+                    const auto c = static_cast<float>(i) / (kEncodeTableSize - 1);
+                    const auto encoded = c <= .0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.f / 2.4f) - .055f;
+                    res[i] = static_cast<uint8_t>(std::clamp(encoded, 0.f, 1.f) * 255.f + .5f);
+                }
+                return res;
+            }();
+            return table.data();
+        }
+
+        // dst is srcWidth / 2 x srcHeight / 2, so the odd last column / row of src is only read where a side is already 1
+        inline void downsample(const uint8_t *src, uint32_t srcWidth, uint32_t srcHeight, uint8_t *dst, bool srgb)
+        {
+            const auto dstWidth = std::max(srcWidth >> 1, 1U), dstHeight = std::max(srcHeight >> 1, 1U);
+            const auto stepX = srcWidth > 1 ? 4U : 0U;
+            const auto stepY = srcHeight > 1 ? static_cast<size_t>(srcWidth) * 4 : 0ULL;
+            const auto *toLinear = srgbToLinearTable();
+            const auto *toSrgb = linearToSrgbTable();
+            for (auto y = 0U; y < dstHeight; ++y)
+            {
+                const auto *row0 = src + static_cast<size_t>(2 * y) * srcWidth * 4;
+                const auto *row1 = row0 + stepY;
+                auto *out = dst + static_cast<size_t>(y) * dstWidth * 4;
+                auto average = [&](uint32_t i)
+                { return static_cast<uint8_t>((row0[i] + row0[i + stepX] + row1[i] + row1[i + stepX] + 2) >> 2); };
+                if (!srgb)
+                {
+                    // byte i of out averages bytes 2 * i - i % 4 and the same channel of the next pixel, in both rows
+                    for (auto i = 0U; i < dstWidth * 4; ++i)
+                        out[i] = average(2 * i - (i & 3U));
+                    continue;
+                }
+                for (auto x = 0U; x < dstWidth; ++x)
+                {
+                    for (auto c = 0U; c < 3; ++c)
+                    {
+                        const auto i = 8 * x + c;
+                        const auto sum = toLinear[row0[i]] + toLinear[row0[i + stepX]] + toLinear[row1[i]] + toLinear[row1[i + stepX]];
+                        out[4 * x + c] = toSrgb[static_cast<uint32_t>(sum * (.25f * (kEncodeTableSize - 1)) + .5f)];
+                    }
+                    out[4 * x + 3] = average(8 * x + 3);
+                }
+            }
+        }
+    }
+
+    // pixels holds level 0 and has room for the mipChainSize of the whole chain, levels are appended after it
+    inline void generateMips(uint8_t *pixels, uint32_t width, uint32_t height, uint32_t levelCount, bool srgb)
+    {
+        auto *src = pixels;
+        for (auto level = 1U; level < levelCount; ++level)
+        {
+            const auto srcWidth = std::max(width >> (level - 1), 1U), srcHeight = std::max(height >> (level - 1), 1U);
+            auto *dst = src + static_cast<size_t>(srcWidth) * srcHeight * 4;
+            detail::downsample(src, srcWidth, srcHeight, dst, srgb);
+            src = dst;
+        }
+    }
+}
\ No newline at end of file
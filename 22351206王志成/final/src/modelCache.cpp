@@ -0,0 +1,391 @@
+#include <fstream>
+
+#include <nvh/filemapping.hpp>
+
+#include "jobSystem.hpp"
+#include "modelLoader.h"
+
+// binary layout of a cache file:
+//   sCacheHeader | key string | meshes | materials | texture refs
+// every array is padded to 16 bytes so the mapped data keeps the alignment of VertexAttribute, FaceAttribute & Meshlet
+namespace
+{
+    constexpr uint32_t cacheMagic = 0x48434647U; // "GFCH"
+    constexpr uint32_t cacheVersion = 11U;
+    constexpr size_t cacheAlignment = 16ULL;
+
+    struct sCacheHeader
+    {
+        uint32_t magic{cacheMagic};
+        uint32_t version{cacheVersion};
+        uint64_t keyHash{};
+        uint64_t meshCount{};
+        uint64_t materialCount{};
+        uint64_t textureCount{};
+        uint64_t _{};
+    };
+
+    uint64_t fnv1a(std::string_view str)
+    {
+        uint64_t hash = 0xcbf29ce484222325ULL;
+        for (const auto c : str)
+        {
+            hash ^= static_cast<uint8_t>(c);
+            hash *= 0x100000001b3ULL;
+        }
+        return hash;
+    }
+
+    // the material libraries named by the OBJ's mtllib statements, resolved like rapidobj does:
+    // against materialPath when given, next to the OBJ otherwise
+    std::vector<std::filesystem::path> findMaterialLibraries(const std::filesystem::path &filePath, const std::filesystem::path &materialPath)
+    {
+        std::vector<std::filesystem::path> libraries{};
+        nvh::FileReadMapping mapping;
+        if (!mapping.open(filePath.generic_string().c_str()))
+            return libraries;
+        const std::string_view text(static_cast<const char *>(mapping.data()), mapping.size());
+        const auto directory = materialPath.empty() ? filePath.parent_path() : materialPath;
+        for (size_t lineBegin = 0; lineBegin < text.size();)
+        {
+            auto lineEnd = text.find('\n', lineBegin);
+            lineEnd = lineEnd == std::string_view::npos ? text.size() : lineEnd;
+            auto line = text.substr(lineBegin, lineEnd - lineBegin);
+            lineBegin = lineEnd + 1;
+            line.remove_prefix(std::min(line.find_first_not_of(" \t"), line.size()));
+            if (!line.starts_with("mtllib") || line.size() < 7 || (line[6] != ' ' && line[6] != '\t'))
+                continue;
+            // one statement may name several libraries
+            line.remove_prefix(6);
+            while (!line.empty())
+            {
+                line.remove_prefix(std::min(line.find_first_not_of(" \t\r"), line.size()));
+                const auto nameEnd = std::min(line.find_first_of(" \t\r"), line.size());
+                if (nameEnd > 0)
+                    libraries.emplace_back(directory / std::string(line.substr(0, nameEnd)));
+                line.remove_prefix(nameEnd);
+            }
+        }
+        return libraries;
+    }
+
+    // everything that can change the processed result goes into the key, including the material libraries' versions
+    std::string makeCacheKey(const std::filesystem::path &filePath, const std::filesystem::path &texPath, const std::filesystem::path &materialPath,
+                             const LoaderOptions &options)
+    {
+        std::error_code error;
+        auto key = std::filesystem::absolute(filePath, error).generic_string();
+        key += "|" + std::to_string(std::filesystem::last_write_time(filePath, error).time_since_epoch().count());
+        key += "|" + std::to_string(std::filesystem::file_size(filePath, error));
+        for (const auto &library : findMaterialLibraries(filePath, materialPath))
+        {
+            // missing libraries count as well, their materials fall back to the defaults
+            key += "|" + library.generic_string();
+            key += "|" + std::to_string(std::filesystem::last_write_time(library, error).time_since_epoch().count());
+            key += "|" + std::to_string(std::filesystem::file_size(library, error));
+        }
+        key += "|" + texPath.generic_string();
+        key += "|" + materialPath.generic_string();
+        key += "|" + std::to_string(options.interpVertexNormal);
+        key += "|" + std::to_string(options.optimizeMeshes);
+        key += "|" + std::to_string(options.buildMeshlets);
+        key += "|" + std::to_string(options.buildLods);
+        return key;
+    }
+
+    std::filesystem::path makeCachePath(const std::string &key, const LoaderOptions &options)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(fnv1a(key)));
+        return options.cacheDirectory / name;
+    }
+
+    class sCacheWriter
+    {
+    public:
+        explicit sCacheWriter(const std::filesystem::path &path) : m_output(path, std::ios::out | std::ios::binary | std::ios::trunc) {}
+
+        bool good() const { return m_output.good(); }
+
+        template <typename T>
+        void write(const T &value)
+        {
+            static_assert(std::is_trivially_copyable_v<T>);
+            writeBytes(&value, sizeof(T));
+        }
+
+        void writeString(const std::string &str)
+        {
+            write(static_cast<uint64_t>(str.size()));
+            writeBytes(str.data(), str.size());
+            pad();
+        }
+
+        template <typename T>
+        void writeArray(const std::vector<T> &vec)
+        {
+            static_assert(std::is_trivially_copyable_v<T>);
+            write(static_cast<uint64_t>(vec.size()));
+            pad();
+            writeBytes(vec.data(), vec.size() * sizeof(T));
+            pad();
+        }
+
+    private:
+        void writeBytes(const void *data, size_t size)
+        {
+            m_output.write(static_cast<const char *>(data), size);
+            m_offset += size;
+        }
+
+        void pad()
+        {
+            static const char zeros[cacheAlignment]{};
+            const auto padding = (cacheAlignment - m_offset % cacheAlignment) % cacheAlignment;
+            writeBytes(zeros, padding);
+        }
+
+        std::ofstream m_output;
+        size_t m_offset{0ULL};
+    };
+
+    // reads directly from the mapped file, every access is bounds checked so a truncated cache is rejected instead of crashing
+    class sCacheReader
+    {
+    public:
+        sCacheReader(const void *data, size_t size) : m_data(static_cast<const uint8_t *>(data)), m_size(size) {}
+
+        bool ok() const { return m_ok; }
+
+        template <typename T>
+        T read()
+        {
+            T value{};
+            if (const auto ptr = readBytes(sizeof(T)))
+                memcpy(&value, ptr, sizeof(T));
+            return value;
+        }
+
+        std::string readString()
+        {
+            const auto size = read<uint64_t>();
+            const auto ptr = readBytes(size);
+            pad();
+            return ptr ? std::string(reinterpret_cast<const char *>(ptr), size) : std::string{};
+        }
+
+        template <typename T>
+        void readArray(std::vector<T> &vec)
+        {
+            const auto count = read<uint64_t>();
+            pad();
+            if (!m_ok || count > (m_size - m_offset) / sizeof(T))
+            {
+                m_ok = false;
+                return;
+            }
+            const auto ptr = reinterpret_cast<const T *>(readBytes(count * sizeof(T)));
+            vec.assign(ptr, ptr + count);
+            pad();
+        }
+
+    private:
+        const uint8_t *readBytes(size_t size)
+        {
+            if (!m_ok || size > m_size - m_offset)
+            {
+                m_ok = false;
+                return nullptr;
+            }
+            const auto ptr = m_data + m_offset;
+            m_offset += size;
+            return ptr;
+        }
+
+        void pad()
+        {
+            m_offset = std::min(m_size, (m_offset + cacheAlignment - 1) / cacheAlignment * cacheAlignment);
+        }
+
+        const uint8_t *m_data{nullptr};
+        size_t m_size{0ULL};
+        size_t m_offset{0ULL};
+        bool m_ok{true};
+    };
+}
+
+bool ModelLoader::loadCache(std::vector<Mesh> &meshContainer, std::vector<Material> &matContainer, std::vector<Texture> &texContainer,
+                            const std::filesystem::path &filePath, const std::filesystem::path &texPath, const std::filesystem::path &materialPath,
+                            const LoaderOptions &options, LoadingProgress *progress)
+{
+    const auto key = makeCacheKey(filePath, texPath, materialPath, options);
+    const auto cachePath = makeCachePath(key, options);
+    if (!std::filesystem::exists(cachePath))
+        return false;
+
+    nvh::FileReadMapping mapping;
+    if (!mapping.open(cachePath.generic_string().c_str()))
+        return false;
+
+    sCacheReader reader(mapping.data(), mapping.size());
+    const auto header = reader.read<sCacheHeader>();
+    if (!reader.ok() || header.magic != cacheMagic || header.version != cacheVersion || header.keyHash != fnv1a(key) || reader.readString() != key)
+    {
+        printf("WARNING: model cache [%s] is outdated, reloading model [%s].\n", cachePath.generic_string().c_str(), filePath.generic_string().c_str());
+        return false;
+    }
+
+    std::vector<Mesh> meshes(header.meshCount);
+    for (auto &mesh : meshes)
+    {
+        mesh.name = reader.readString();
+        mesh.bounding = reader.read<BoundingBox>();
+        reader.readArray(mesh.vertices);
+        reader.readArray(mesh.indices);
+        reader.readArray(mesh.faces);
+        reader.readArray(mesh.meshlets);
+        mesh.acmr = reader.read<std::array<float, 2>>();
+        mesh.atvr = reader.read<std::array<float, 2>>();
+        // clamped so a corrupted count cannot allocate unbounded levels, the reads then fail and reject the cache
+        mesh.lods.resize(std::min<uint64_t>(reader.read<uint64_t>(), kMaxMeshLods));
+        for (auto &lod : mesh.lods)
+        {
+            lod.error = reader.read<float>();
+            reader.readArray(lod.indices);
+            reader.readArray(lod.faces);
+        }
+    }
+
+    std::vector<Material> materials(header.materialCount);
+    for (auto &material : materials)
+    {
+        material.name = reader.readString();
+        material.properties = reader.read<MaterialAttribute>();
+    }
+
+    std::vector<sTextureRef> textureRefs(header.textureCount);
+    for (auto &ref : textureRefs)
+    {
+        ref.name = reader.readString();
+        ref.alphaName = reader.readString();
+        ref.srgb = reader.read<uint8_t>() != 0;
+        ref.bumpScale = reader.read<float>();
+        ref.packed = reader.read<uint8_t>() != 0;
+        for (auto &channelName : ref.channelNames)
+            channelName = reader.readString();
+        ref.keepMask = reader.read<uint32_t>();
+        ref.fillTexel = reader.read<uint32_t>();
+    }
+
+    if (!reader.ok())
+    {
+        printf("WARNING: model cache [%s] is corrupted, reloading model [%s].\n", cachePath.generic_string().c_str(), filePath.generic_string().c_str());
+        return false;
+    }
+
+    // meshes are cached in their optimized order (the option is part of the key),
+    // the compact layout is cheap to rebuild, so it is not part of the cache
+    if (options.quantizeVertices)
+        JobSystem::getInstance().parallelFor<1>(meshes.size(), [&](uint64_t meshIndex)
+                                                { meshes[meshIndex].quantize(); });
+    meshContainer = std::move(meshes);
+    matContainer = std::move(materials);
+    if (progress)
+    {
+        progress->addWork(static_cast<uint32_t>(1 + meshContainer.size() + textureRefs.size()));
+        progress->advance();
+        if (progress->onMaterialsLoaded)
+            progress->onMaterialsLoaded(matContainer, textureRefs.size());
+        for (auto i = 0U; i < meshContainer.size(); ++i)
+        {
+            progress->advance();
+            if (progress->onMeshLoaded)
+                progress->onMeshLoaded(i, meshContainer[i]);
+        }
+        progress->setStage("decoding textures of " + filePath.filename().generic_string());
+    }
+    decodeTextures(textureRefs, texContainer, texPath, options, progress);
+    return true;
+}
+
+void ModelLoader::saveCache(const std::vector<Mesh> &meshContainer, const std::vector<Material> &matContainer, const std::vector<sTextureRef> &textureRefs,
+                            const std::filesystem::path &filePath, const std::filesystem::path &texPath, const std::filesystem::path &materialPath,
+                            const LoaderOptions &options)
+{
+    std::error_code error;
+    std::filesystem::create_directories(options.cacheDirectory, error);
+
+    const auto key = makeCacheKey(filePath, texPath, materialPath, options);
+    const auto cachePath = makeCachePath(key, options);
+    // write to a temporary file first, so an interrupted write never leaves a valid-looking cache behind
+    auto tempPath = cachePath;
+    tempPath += ".tmp";
+    auto written = false;
+    {
+        sCacheWriter writer(tempPath);
+        if (!writer.good())
+        {
+            printf("WARNING: Failed to open output cache file corresponding to loaded model [%s].\n", filePath.generic_string().c_str());
+            return;
+        }
+
+        sCacheHeader header{};
+        header.keyHash = fnv1a(key);
+        header.meshCount = meshContainer.size();
+        header.materialCount = matContainer.size();
+        header.textureCount = textureRefs.size();
+        writer.write(header);
+        writer.writeString(key);
+
+        // the loader works with model local material/texture indices, so they are stored as-is
+        for (const auto &mesh : meshContainer)
+        {
+            writer.writeString(mesh.name);
+            writer.write(mesh.bounding);
+            writer.writeArray(mesh.vertices);
+            writer.writeArray(mesh.indices);
+            writer.writeArray(mesh.faces);
+            writer.writeArray(mesh.meshlets);
+            writer.write(mesh.acmr);
+            writer.write(mesh.atvr);
+            writer.write(static_cast<uint64_t>(mesh.lods.size()));
+            for (const auto &lod : mesh.lods)
+            {
+                writer.write(lod.error);
+                writer.writeArray(lod.indices);
+                writer.writeArray(lod.faces);
+            }
+        }
+
+        for (const auto &material : matContainer)
+        {
+            writer.writeString(material.name);
+            writer.write(material.properties);
+        }
+
+        for (const auto &ref : textureRefs)
+        {
+            writer.writeString(ref.name);
+            writer.writeString(ref.alphaName);
+            writer.write(static_cast<uint8_t>(ref.srgb));
+            writer.write(ref.bumpScale);
+            writer.write(static_cast<uint8_t>(ref.packed));
+            for (const auto &channelName : ref.channelNames)
+                writer.writeString(channelName);
+            writer.write(ref.keepMask);
+            writer.write(ref.fillTexel);
+        }
+
+        written = writer.good();
+    }
+    if (!written)
+    {
+        printf("WARNING: Failed to write model cache [%s].\n", cachePath.generic_string().c_str());
+        std::filesystem::remove(tempPath, error);
+        return;
+    }
+
+    std::filesystem::rename(tempPath, cachePath, error);
+    if (error)
+        printf("WARNING: Failed to write model cache [%s]: %s.\n", cachePath.generic_string().c_str(), error.message().c_str());
+}
\ No newline at end of file
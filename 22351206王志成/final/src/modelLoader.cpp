@@ -1,277 +1,499 @@
 #include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <unordered_map>
-#include <thread>
 
 #include <stb_image.h>
-#include <alpaca/alpaca.h>
 
+#include "jobSystem.hpp"
 #include "modelLoader.h"
+#include "meshOptimizer.hpp"
+#include "meshletBuilder.hpp"
+#include "meshSimplifier.hpp"
+#include "mipGenerator.hpp"
+#include "textureProcessor.hpp"
+#include "vertexWelder.hpp"
+#include "normalGenerator.hpp"
 
-// bool ModelLoader::loadCache(std::vector<Mesh> &meshContainer, std::vector<Texture> &texContainer, std::vector<Material> &matContainer, const std::filesystem::path &filePath)
-// {
-//     auto cachePath = filePath / ".cache";
-//     std::ifstream input(cachePath, std::ios::in | std::ios::binary);
-//     if (!input)
-//         return false;
-
-//     std::error_code error;
-//     auto size = std::filesystem::file_size(cachePath);
-//     struct sMergedMeshContainer
-//     {
-//         std::vector<Mesh> _;
-//     };
-//     auto read = alpaca::deserialize<sMergedMeshContainer>(input, size, error);
-//     if (!error)
-//         throw std::runtime_error("found model cache [" + cachePath.generic_string() + "], but deserialized with error " + error.message() + ".\n");
-
-//     meshContainer = read._;
-//     input.close();
-//     return true;
-// }
+namespace
+{
+    // shapes with more corners than this are split across all threads instead of occupying a single worker
+    constexpr size_t largeShapeCornerCount = 1ULL << 20;
+    // height in texels of a full range bump map at -bm 1, bump maps are authored without any unit
+    constexpr float bumpHeightTexels = 8.f;
+
+    // smoothNormal is used for corners without an explicit normal, may be nullptr
+    VertexAttribute makeCorner(const rapidobj::Attributes &attributes, const rapidobj::Index &index, const nvmath::vec3f *smoothNormal)
+    {
+        VertexAttribute temp{};
+
+        temp.position = {
+            attributes.positions[3 * index.position_index + 0],
+            attributes.positions[3 * index.position_index + 1],
+            attributes.positions[3 * index.position_index + 2]};
+        if (index.normal_index != -1)
+            temp.normal = {
+                attributes.normals[3 * index.normal_index + 0],
+                attributes.normals[3 * index.normal_index + 1],
+                attributes.normals[3 * index.normal_index + 2]};
+        else if (smoothNormal != nullptr)
+            temp.normal = *smoothNormal;
+        if (index.texcoord_index != -1)
+        {
+            temp.uv = {
+                attributes.texcoords[2 * index.texcoord_index + 0],
+                attributes.texcoords[2 * index.texcoord_index + 1]};
+            // remap coords to [0, 1]
+            temp.uv.x -= std::floor(temp.uv.x);
+            temp.uv.y -= std::floor(temp.uv.y);
+            // according to Vulkan's coord system
+            temp.uv.y = 1.f - temp.uv.y;
+        }
+        return temp;
+    }
+
+    BoundingBox computeBounding(const std::vector<VertexAttribute> &vertices, size_t begin, size_t end)
+    {
+        BoundingBox bounding{};
+        if (begin < end)
+            bounding.minPoint = bounding.maxPoint = vertices[begin].position;
+        for (auto i = begin + 1; i < end; ++i)
+            bounding.extend(vertices[i].position);
+        return bounding;
+    }
+
+    void computeFaceAttributes(const rapidobj::Shape &shape, Mesh &mesh, size_t faceBegin, size_t faceEnd)
+    {
+        for (auto f = faceBegin; f < faceEnd; ++f)
+        {
+            // faces without material keep the default index
+            if (shape.mesh.material_ids[f] >= 0)
+                mesh.faces[f].materialIndex = shape.mesh.material_ids[f];
+            // assume triangle faces' front are CCW
+            auto vec1 = nvmath::normalize(mesh.vertices[mesh.indices[3 * f + 1]].position - mesh.vertices[mesh.indices[3 * f + 0]].position);
+            auto vec2 = nvmath::normalize(mesh.vertices[mesh.indices[3 * f + 2]].position - mesh.vertices[mesh.indices[3 * f + 1]].position);
+            mesh.faces[f].normal = nvmath::normalize(nvmath::cross(vec1, vec2));
+        }
+    }
+
+    // smooth normals have to exist before welding, so corners of different smoothing groups are never merged
+    std::vector<nvmath::vec3f> generateShapeNormals(const rapidobj::Attributes &attributes, const rapidobj::Shape &shape, uint32_t numThreads)
+    {
+        std::vector<nvmath::vec3f> normals{};
+        generateSmoothNormals(
+            shape.mesh.indices.size(), [&](size_t corner)
+            { return shape.mesh.indices[corner].position_index; },
+            attributes.positions.data(), shape.mesh.smoothing_group_ids.data(), normals, numThreads);
+        return normals;
+    }
+
+    // single-threaded path used by the per-shape workers
+    void processShape(const rapidobj::Attributes &attributes, const rapidobj::Shape &shape, Mesh &mesh, bool interpVertexNormal, LoaderTimings *timings)
+    {
+        std::vector<nvmath::vec3f> smoothNormals{};
+        if (interpVertexNormal)
+        {
+            LoaderTimings::Scope scope(timings, LoaderPhase::smoothNormals);
+            smoothNormals = generateShapeNormals(attributes, shape, 1);
+        }
+
+        mesh.name = shape.name;
+        {
+            // avoid vertex duplicate
+            LoaderTimings::Scope scope(timings, LoaderPhase::weld);
+            VertexWelder welder(shape.mesh.indices.size() / 4);
+            mesh.vertices.reserve(shape.mesh.indices.size());
+            mesh.indices.reserve(shape.mesh.indices.size());
+            for (auto c = 0ULL; c < shape.mesh.indices.size(); ++c)
+                mesh.indices.emplace_back(welder.weld(makeCorner(attributes, shape.mesh.indices[c], smoothNormals.empty() ? nullptr : &smoothNormals[c]), mesh.vertices));
+            mesh.vertices.shrink_to_fit();
+            mesh.bounding = computeBounding(mesh.vertices, 0, mesh.vertices.size());
+        }
+
+        LoaderTimings::Scope scope(timings, LoaderPhase::faceNormals);
+        mesh.faces.resize(shape.mesh.material_ids.size());
+        computeFaceAttributes(shape, mesh, 0, mesh.faces.size());
+    }
+
+    // same result as processShape, but every stage is split into chunks processed by all threads
+    // its phases run on all threads, they add their wall time
+    void processLargeShape(const rapidobj::Attributes &attributes, const rapidobj::Shape &shape, Mesh &mesh, bool interpVertexNormal, uint32_t numThreads,
+                           LoaderTimings *timings)
+    {
+        std::vector<nvmath::vec3f> smoothNormals{};
+        if (interpVertexNormal)
+        {
+            LoaderTimings::Scope scope(timings, LoaderPhase::smoothNormals);
+            smoothNormals = generateShapeNormals(attributes, shape, numThreads);
+        }
+
+        mesh.name = shape.name;
+        {
+            LoaderTimings::Scope scope(timings, LoaderPhase::weld);
+            weldParallel(
+                shape.mesh.indices.size(), [&](size_t corner)
+                { return makeCorner(attributes, shape.mesh.indices[corner], smoothNormals.empty() ? nullptr : &smoothNormals[corner]); },
+                mesh.vertices, mesh.indices, numThreads);
+
+            std::vector<BoundingBox> chunkBounding(numThreads);
+            const auto vertexChunkSize = (mesh.vertices.size() + numThreads - 1) / numThreads;
+            JobSystem::getInstance().parallelFor<1>(numThreads, [&](uint64_t chunk)
+                                                    { chunkBounding[chunk] = computeBounding(mesh.vertices, std::min(mesh.vertices.size(), chunk * vertexChunkSize),
+                                                                                             std::min(mesh.vertices.size(), (chunk + 1) * vertexChunkSize)); }, numThreads);
+            mesh.bounding = chunkBounding.front();
+            for (auto chunk = 1ULL; chunk * vertexChunkSize < mesh.vertices.size(); ++chunk)
+            {
+                mesh.bounding.extend(chunkBounding[chunk].minPoint);
+                mesh.bounding.extend(chunkBounding[chunk].maxPoint);
+            }
+        }
+
+        LoaderTimings::Scope scope(timings, LoaderPhase::faceNormals);
+        mesh.faces.resize(shape.mesh.material_ids.size());
+        JobSystem::getInstance().parallelRanges<4096>(mesh.faces.size(), [&](uint64_t faceBegin, uint64_t faceEnd, uint32_t)
+                                                      { computeFaceAttributes(shape, mesh, faceBegin, faceEnd); }, numThreads);
+    }
+}
 
 void ModelLoader::fullyReload(std::vector<Mesh> &meshContainer, std::vector<Material> &matContainer, std::vector<Texture> &texContainer,
                               const std::filesystem::path &filePath, const std::filesystem::path &texPath, const std::filesystem::path &materialPath,
-                              bool interpVertexNormal)
+                              const LoaderOptions &options, LoadingProgress *progress)
 {
-    auto data = rapidobj::ParseFile(filePath, materialPath.empty() ? rapidobj::MaterialLibrary::Default() : rapidobj::MaterialLibrary::SearchPath(materialPath));
+    if (progress)
+        progress->setStage("parsing " + filePath.filename().generic_string());
+    auto *timings = getTimings(progress);
+    rapidobj::Result data{};
+    {
+        LoaderTimings::Scope scope(timings, LoaderPhase::parse);
+        data = rapidobj::ParseFile(filePath, materialPath.empty() ? rapidobj::MaterialLibrary::Default() : rapidobj::MaterialLibrary::SearchPath(materialPath));
+    }
     if (data.error)
         throw std::runtime_error(data.error.code.message());
-    if (!rapidobj::Triangulate(data))
-        throw std::runtime_error("loaded model [" + filePath.generic_string() + "] is failed to triangulate.\n");
-
-    meshContainer.resize(data.shapes.size());
-    std::vector<sMeshTask> task(data.shapes.size());
-    for (auto i = 0; i < data.shapes.size(); ++i)
     {
-        task[i].loadedData = &data;
-        task[i].targetMesh = &meshContainer[i];
-        task[i].shapeIndex = i;
+        LoaderTimings::Scope scope(timings, LoaderPhase::triangulate);
+        if (!rapidobj::Triangulate(data))
+            throw std::runtime_error("loaded model [" + filePath.generic_string() + "] is failed to triangulate.\n");
     }
 
-    auto concurrency = std::min(static_cast<size_t>(std::thread::hardware_concurrency()), task.size());
-    auto threads = std::vector<std::thread>{};
-    threads.reserve(concurrency);
-
-    auto taskIndex = std::atomic_size_t{0ULL};
-    auto activeThreads = std::atomic_size_t{concurrency};
-    auto completed = std::promise<void>{};
+    if (progress && progress->cancelled())
+        return;
+    auto &jobSystem = JobSystem::getInstance();
+    const auto hardwareConcurrency = jobSystem.getConcurrency();
 
-    auto workerFunc = [&]()
+    std::vector<sTextureRef> textureRefs{};
+    std::unordered_map<std::string, uint32_t> texMap{};
+    // textures are shared by their whole recipe, the same image can be used as-is and converted
+    auto acquireTexture = [&](const sTextureRef &ref)
     {
-        auto activeTaskIndex = std::atomic_fetch_add(&taskIndex, 1ULL);
-        while (activeTaskIndex < task.size())
+        auto key = ref.name + "|" + ref.alphaName + "|" + std::to_string(ref.bumpScale) + "|" + std::to_string(ref.packed) + "|" +
+                   std::to_string(ref.keepMask) + "|" + std::to_string(ref.fillTexel);
+        for (const auto &channelName : ref.channelNames)
+            key += "|" + channelName;
+        if (texMap.find(key) == texMap.end())
         {
-            {
-                // avoid vertex duplicate
-                std::unordered_map<VertexAttribute, uint32_t> verticesMap;
-                // for vertex normal interpolation
-                // smooth_group_index -> vertex_index -> face_index
-                std::unordered_map<uint32_t, std::unordered_map<uint32_t, std::vector<uint32_t>>> smoothGroupMap;
-
-                auto attributes = &task[activeTaskIndex].loadedData->attributes;
-                auto shape = &task[activeTaskIndex].loadedData->shapes[task[activeTaskIndex].shapeIndex];
-                auto mesh = task[activeTaskIndex].targetMesh;
-                mesh->name = shape->name;
-                mesh->vertices.reserve(shape->mesh.indices.size());
-                mesh->indices.reserve(shape->mesh.indices.size());
-                for (const auto &index : shape->mesh.indices)
-                {
-                    VertexAttribute temp{};
-
-                    temp.position = {
-                        attributes->positions[3 * index.position_index + 0],
-                        attributes->positions[3 * index.position_index + 1],
-                        attributes->positions[3 * index.position_index + 2]};
-                    if (index.normal_index != -1)
-                        temp.normal = {
-                            attributes->normals[3 * index.normal_index + 0],
-                            attributes->normals[3 * index.normal_index + 1],
-                            attributes->normals[3 * index.normal_index + 2]};
-                    // else if (!interpVertexNormal)
-                    //     printf("WARNING: Loaded model [%s] has missing vertex normal and interpVertexNormal flag is off.\n", filePath.generic_string());
-                    if (index.texcoord_index != -1)
-                    {
-                        temp.uv = {
-                            attributes->texcoords[2 * index.texcoord_index + 0],
-                            attributes->texcoords[2 * index.texcoord_index + 1]};
-                        // remap coords to [0, 1]
-                        temp.uv.x -= std::floor(temp.uv.x);
-                        temp.uv.y -= std::floor(temp.uv.y);
-                        // according to Vulkan's coord system
-                        temp.uv.y = 1.f - temp.uv.y;
-                    }
-
-                    if (verticesMap.count(temp) == 0)
-                    {
-                        verticesMap[temp] = mesh->vertices.size();
-                        mesh->vertices.emplace_back(temp);
-                        if (mesh->bounding.minPoint == nvmath::vec3f_zero && mesh->bounding.maxPoint == nvmath::vec3f_zero)
-                            mesh->bounding.minPoint = mesh->bounding.maxPoint = temp.position;
-                        else
-                            mesh->bounding.extend(temp.position);
-                    }
-                    mesh->indices.emplace_back(verticesMap[temp]);
-                }
-                mesh->vertices.shrink_to_fit();
-                mesh->indices.shrink_to_fit();
-
-                mesh->faces.resize(shape->mesh.material_ids.size());
-                auto maxSmoothGroupIndex = 0U;
-                for (auto f = 0; f < shape->mesh.material_ids.size(); ++f)
-                {
-                    mesh->faces[f].materialIndex = shape->mesh.material_ids[f] + matContainer.size();
-                    // assume triangle faces' front are CCW
-                    auto vec1 = nvmath::normalize(mesh->vertices[mesh->indices[3 * f + 1]].position - mesh->vertices[mesh->indices[3 * f + 0]].position);
-                    auto vec2 = nvmath::normalize(mesh->vertices[mesh->indices[3 * f + 2]].position - mesh->vertices[mesh->indices[3 * f + 1]].position);
-                    mesh->faces[f].normal = nvmath::normalize(nvmath::cross(vec1, vec2));
-                    // allocate interp task
-                    if (interpVertexNormal)
-                    {
-                        maxSmoothGroupIndex = std::max(maxSmoothGroupIndex, shape->mesh.smoothing_group_ids[f]);
-                        if (shape->mesh.indices[3 * f + 0].normal_index == -1)
-                            smoothGroupMap[shape->mesh.smoothing_group_ids[f]][mesh->indices[3 * f + 0]].emplace_back(f);
-                        if (shape->mesh.indices[3 * f + 1].normal_index == -1)
-                            smoothGroupMap[shape->mesh.smoothing_group_ids[f]][mesh->indices[3 * f + 1]].emplace_back(f);
-                        if (shape->mesh.indices[3 * f + 2].normal_index == -1)
-                            smoothGroupMap[shape->mesh.smoothing_group_ids[f]][mesh->indices[3 * f + 2]].emplace_back(f);
-                    }
-                }
+            texMap[key] = textureRefs.size();
+            textureRefs.emplace_back(ref);
+        }
+        return texMap[key];
+    };
+    {
+        LoaderTimings::Scope scope(timings, LoaderPhase::materials);
+        for (const auto &material : data.materials)
+        {
+            Material temp{};
+            temp.name = material.name;
+            memcpy(&temp.properties.ambient, material.ambient.data(), 3 * sizeof(float));
+            memcpy(&temp.properties.diffuse, material.diffuse.data(), 3 * sizeof(float));
+            memcpy(&temp.properties.specular, material.specular.data(), 3 * sizeof(float));
+            memcpy(&temp.properties.transmittance, material.transmittance.data(), 3 * sizeof(float));
+            memcpy(&temp.properties.emission, material.emission.data(), 3 * sizeof(float));
+            temp.properties.dissolve = material.dissolve;
+            temp.properties.illum = material.illum;
+            temp.properties.shininess = material.shininess;
+            temp.properties.ior = material.ior;
+            temp.properties.roughness = material.roughness;
+            temp.properties.metallic = material.metallic;
+            temp.properties.sheen = material.sheen;
+            temp.properties.clearcoat_roughness = material.clearcoat_roughness;
+            temp.properties.clearcoat_thickness = material.clearcoat_thickness;
+            temp.properties.anisotropy = material.anisotropy;
+            temp.properties.anisotropy_rotation = material.anisotropy_rotation;
 
-                if (interpVertexNormal)
+            if (!texPath.empty())
+            {
+                if (!material.diffuse_texname.empty())
+                    temp.properties.diffuse_map_index = acquireTexture({.name = material.diffuse_texname, .alphaName = material.alpha_texname});
+                if (!material.reflection_texname.empty())
+                    temp.properties.reflection_map_index = acquireTexture({.name = material.reflection_texname});
+                // RGB -> specular color, A -> shininess scale
+                if (!material.specular_texname.empty())
+                    temp.properties.specular_map_index = acquireTexture({.name = material.specular_texname, .alphaName = material.specular_highlight_texname});
+                // normal maps are taken as-is, bump maps are converted; missing ones are flat
+                if (!material.normal_texname.empty())
+                    temp.properties.normal_map_index = acquireTexture({.name = material.normal_texname, .srgb = false, .fillTexel = flatNormalTexel});
+                else if (!material.bump_texname.empty())
+                    temp.properties.normal_map_index = acquireTexture({.name = material.bump_texname, .srgb = false,
+                                                                       .bumpScale = bumpHeightTexels * material.bump_texopt.bump_multiplier,
+                                                                       .fillTexel = flatNormalTexel});
+                // R -> AO (no OBJ map), G -> roughness, B -> metallic, A -> emissive luminance, the glTF layout plus emission
+                // the map holds the values & the scalars become plain factors; channels without a map hold the scalar's value,
+                // or the neutral one when it isn't set: roughness 1, metallic 0, no emission
+                if (!material.metallic_texname.empty() || !material.roughness_texname.empty() || !material.emissive_texname.empty())
                 {
-                    for (auto i = 0; i < maxSmoothGroupIndex; ++i)
-                    {
-                        if (!smoothGroupMap.contains(i))
-                            continue;
-
-                        for (const auto &iter : smoothGroupMap[i])
-                        {
-                            auto &vertex = mesh->vertices[iter.first];
-                            auto temp = nvmath::vec3f_zero;
-                            for (const auto &faceIndex : iter.second)
-                                temp += mesh->faces[faceIndex].normal;
-                            temp = nvmath::normalize(temp);
-                            vertex.normal = temp;
-                        }
-                    }
+                    const auto roughness = material.roughness > 0.f ? material.roughness : 1.f;
+                    const auto hasEmission = material.emission[0] > 0.f || material.emission[1] > 0.f || material.emission[2] > 0.f;
+                    const auto fillTexel = 0xFFU | static_cast<uint32_t>(std::clamp(roughness, 0.f, 1.f) * 255.f + .5f) << 8 |
+                                           static_cast<uint32_t>(std::clamp(material.metallic, 0.f, 1.f) * 255.f + .5f) << 16 |
+                                           (hasEmission && material.emissive_texname.empty() ? 0xFF000000U : 0U);
+                    temp.properties.roughness = 1.f;
+                    temp.properties.metallic = 1.f;
+                    if (!hasEmission)
+                        temp.properties.emission = {1.f, 1.f, 1.f};
+                    temp.properties.basic_pbr_map_index = acquireTexture({.name = material.name + " (pbr)", .srgb = false, .packed = true,
+                                                                          .channelNames = {"", material.roughness_texname, material.metallic_texname, material.emissive_texname},
+                                                                          .fillTexel = fillTexel});
                 }
             }
-            activeTaskIndex = std::atomic_fetch_add(&taskIndex, 1ULL);
+
+            matContainer.emplace_back(temp);
         }
+    }
+
+    if (texPath.empty())
+        printf("ERROR: Invalid texture input path.\n");
+
+    if (progress)
+    {
+        progress->addWork(static_cast<uint32_t>(1 + data.shapes.size() + textureRefs.size()));
+        progress->advance();
+        progress->setStage("processing " + filePath.filename().generic_string());
+        if (progress->onMaterialsLoaded)
+            progress->onMaterialsLoaded(matContainer, textureRefs.size());
+    }
 
-        if (std::atomic_fetch_sub(&activeThreads, 1ULL) == 1)
-            completed.set_value();
+    // textures are decoded in the background while meshes are processed
+    auto textureDecoding = jobSystem.submit([&]()
+                                            { decodeTextures(textureRefs, texContainer, texPath, options, progress); });
+
+    auto meshLoaded = [&](uint32_t shapeIndex)
+    {
+        if (progress == nullptr)
+            return;
+        progress->advance();
+        if (progress->onMeshLoaded)
+            progress->onMeshLoaded(shapeIndex, meshContainer[shapeIndex]);
     };
 
-    for (auto i = 0; i < concurrency; ++i)
+    meshContainer.resize(data.shapes.size());
+    std::vector<sMeshTask> task{};
+    std::vector<uint32_t> largeShapes{};
+    for (auto i = 0; i < data.shapes.size(); ++i)
     {
-        threads.emplace_back(workerFunc);
-        threads.back().detach();
+        if (data.shapes[i].mesh.indices.size() >= largeShapeCornerCount && hardwareConcurrency > 1)
+        {
+            largeShapes.emplace_back(i);
+            continue;
+        }
+        task.push_back({});
+        task.back().loadedData = &data;
+        task.back().targetMesh = &meshContainer[i];
+        task.back().shapeIndex = i;
     }
 
-    completed.get_future().wait();
+    try
+    {
+        // small shapes are spread over the job system one shape at a time
+        jobSystem.parallelFor<1>(task.size(), [&](uint64_t taskIndex)
+                                 {
+                                     if (progress && progress->cancelled())
+                                         return;
+                                     const auto &current = task[taskIndex];
+                                     processShape(current.loadedData->attributes, current.loadedData->shapes[current.shapeIndex], *current.targetMesh, options.interpVertexNormal, timings);
+                                     postProcessMesh(*current.targetMesh, options, timings);
+                                     meshLoaded(current.shapeIndex); });
 
-    if (texPath.empty())
+        // large shapes get all threads each, so a single giant shape still scales with core count
+        for (const auto shapeIndex : largeShapes)
+        {
+            if (progress && progress->cancelled())
+                break;
+            processLargeShape(data.attributes, data.shapes[shapeIndex], meshContainer[shapeIndex], options.interpVertexNormal, hardwareConcurrency, timings);
+            postProcessMesh(meshContainer[shapeIndex], options, timings);
+            meshLoaded(shapeIndex);
+        }
+    }
+    catch (...)
     {
-        printf("ERROR: Invalid texture input path.\n");
-        return;
+        // the decoding job works on this frame's locals, it has to be finished before unwinding
+        try
+        {
+            jobSystem.wait(textureDecoding);
+        }
+        catch (...)
+        {
+        }
+        throw;
+    }
+
+    jobSystem.wait(textureDecoding);
+
+    // a cancelled load is incomplete and must not be cached
+    if (options.enableCache && !(progress && progress->cancelled()))
+        saveCache(meshContainer, matContainer, textureRefs, filePath, texPath, materialPath, options);
+}
+
+void ModelLoader::postProcessMesh(Mesh &mesh, const LoaderOptions &options, LoaderTimings *timings)
+{
+    LoaderTimings::Scope scope(timings, LoaderPhase::postProcess);
+    // meshlets are built on the cache optimized order and keep it within each meshlet,
+    // vertices are renumbered last as their fetch order depends on the final triangle order
+    // the vertex cache statistics are kept on the mesh, the timings add them up over the whole model
+    const auto triangles = mesh.indices.size() / 3;
+    if (options.optimizeMeshes)
+    {
+        const auto before = MeshOptimizer::analyzeVertexCache(mesh.indices, mesh.vertices.size());
+        mesh.acmr[0] = before.acmr;
+        mesh.atvr[0] = before.atvr;
+        MeshOptimizer::optimizeVertexCache(mesh);
     }
+    if (options.buildMeshlets)
+        MeshletBuilder::buildMeshlets(mesh);
+    if (options.optimizeMeshes)
+    {
+        MeshOptimizer::optimizeVertexFetch(mesh);
+        const auto after = MeshOptimizer::analyzeVertexCache(mesh.indices, mesh.vertices.size());
+        mesh.acmr[1] = after.acmr;
+        mesh.atvr[1] = after.atvr;
+        if (timings != nullptr)
+            timings->addVertexCache(triangles, mesh.vertices.size(), static_cast<uint64_t>(std::llround(mesh.acmr[0] * triangles)),
+                                    static_cast<uint64_t>(std::llround(mesh.acmr[1] * triangles)));
+    }
+    // levels index the final vertex order
+    if (options.buildLods)
+        MeshSimplifier::buildLods(mesh);
+    if (options.quantizeVertices)
+        mesh.quantize();
+}
+
+void ModelLoader::decodeTextures(const std::vector<sTextureRef> &textureRefs, std::vector<Texture> &textures, const std::filesystem::path &texPath,
+                                 const LoaderOptions &options, LoadingProgress *progress)
+{
+    textures.resize(textureRefs.size());
     stbi_set_flip_vertically_on_load(true);
-    std::unordered_map<std::string, uint32_t> texMap{};
-    for (const auto &material : data.materials)
+
+    // every referenced path is unique at this point, so each texture is decoded exactly once
+    auto decode = [&](const sTextureRef &ref, Texture &texture)
     {
-        Material temp{};
-        temp.name = material.name;
-        memcpy(&temp.properties.ambient, material.ambient.data(), 3 * sizeof(float));
-        memcpy(&temp.properties.diffuse, material.diffuse.data(), 3 * sizeof(float));
-        memcpy(&temp.properties.specular, material.specular.data(), 3 * sizeof(float));
-        memcpy(&temp.properties.transmittance, material.transmittance.data(), 3 * sizeof(float));
-        memcpy(&temp.properties.emission, material.emission.data(), 3 * sizeof(float));
-        temp.properties.dissolve = material.dissolve;
-        temp.properties.illum = material.illum;
-        temp.properties.shininess = material.shininess;
-        temp.properties.ior = material.ior;
-        temp.properties.roughness = material.roughness;
-        temp.properties.metallic = material.metallic;
-        temp.properties.sheen = material.sheen;
-        temp.properties.clearcoat_roughness = material.clearcoat_roughness;
-        temp.properties.clearcoat_thickness = material.clearcoat_thickness;
-        temp.properties.anisotropy = material.anisotropy;
-        temp.properties.anisotropy_rotation = material.anisotropy_rotation;
-
-        if (!material.diffuse_texname.empty())
+        LoaderTimings::Scope scope(getTimings(progress), LoaderPhase::textureDecode);
+        if (options.compressTextures && loadTextureCache(ref, texPath, options, texture))
+            return;
+        texture.name = ref.name;
+        texture.format = VK_FORMAT_R8G8B8A8_UNORM;
+
+        // single channel images merged into this texture, they must have its size
+        auto loadChannel = [&](const std::string &name, const char *usage)
         {
-            if (texMap.find(material.diffuse_texname) == texMap.end())
+            int width, height, channel;
+            auto data = stbi_load((texPath / name).generic_string().c_str(), &width, &height, &channel, 1);
+            if (data == nullptr)
+                printf("ERROR: failed to load %s texture [%s]: %s.\n", usage, name.c_str(), stbi_failure_reason());
+            else if (width != texture.width || height != texture.height)
             {
-                texMap[material.diffuse_texname] = texContainer.size();
-                texContainer.push_back({});
-                texContainer.back().name = material.diffuse_texname;
-                texContainer.back().format = VK_FORMAT_R8G8B8A8_UNORM;
-
-                int channel;
-                auto data = stbi_load((texPath / material.diffuse_texname).generic_string().c_str(), &texContainer.back().width, &texContainer.back().height, &channel, 4);
-                texContainer.back().cpuHandle = new unsigned char[texContainer.back().width * texContainer.back().height * 4];
-                memcpy(texContainer.back().cpuHandle, data, texContainer.back().width * texContainer.back().height * 4);
+                printf("ERROR: %s texture [%s] has different size than texture [%s]!\n", usage, name.c_str(), ref.name.c_str());
                 stbi_image_free(data);
+                data = nullptr;
+            }
+            return data;
+        };
 
-                if (!material.alpha_texname.empty())
-                {
-                    int width, height;
-                    auto data = stbi_load((texPath / material.alpha_texname).generic_string().c_str(), &width, &height, &channel, 0);
-                    if (width != texContainer.back().width || height != texContainer.back().height)
-                        printf("ERROR: alpha texture has different size than diffuse texture!\n");
-                    else
-                    {
-                        if (channel > 1)
-                            printf("WARNING: alpha texture has more than 1 channel, only the first channel will be considered.\n");
-
-                        for (auto x = 0; x < width; ++x)
-                            for (auto y = 0; y < width; ++y)
-                                *(static_cast<unsigned char*>(texContainer.back().cpuHandle) + (y * width * 4) + x * 4 + 3) =
-                                    *(data + (y * width * channel) + x * channel);
-                    }
-                    stbi_image_free(data);
-                }
+        int channel;
+        if (ref.packed)
+        {
+            // the first readable channel image gives the size
+            for (const auto &channelName : ref.channelNames)
+                if (!channelName.empty() && stbi_info((texPath / channelName).generic_string().c_str(), &texture.width, &texture.height, &channel))
+                    break;
+            if (texture.width > 0 && texture.height > 0)
+            {
+                texture.cpuHandle = malloc(static_cast<size_t>(texture.width) * texture.height * 4);
+                if (texture.cpuHandle != nullptr)
+                    TextureProcessor::fillTexels(static_cast<uint8_t *>(texture.cpuHandle), ref.fillTexel, static_cast<size_t>(texture.width) * texture.height);
             }
-            temp.properties.diffuse_map_index = texMap[material.diffuse_texname];
+        }
+        else if (ref.bumpScale > 0.f)
+        {
+            auto heights = stbi_load((texPath / ref.name).generic_string().c_str(), &texture.width, &texture.height, &channel, 1);
+            if (heights != nullptr)
+            {
+                texture.cpuHandle = malloc(static_cast<size_t>(texture.width) * texture.height * 4);
+                TextureProcessor::bumpToNormal(heights, texture.width, texture.height, ref.bumpScale, static_cast<uint8_t *>(texture.cpuHandle));
+                stbi_image_free(heights);
+            }
+        }
+        else
+            // stb_image's buffer is kept as the texture storage, no extra copy
+            texture.cpuHandle = ref.encoded ? stbi_load_from_memory(ref.encoded, static_cast<int>(ref.encodedSize), &texture.width, &texture.height, &channel, 4)
+                                            : stbi_load((texPath / ref.name).generic_string().c_str(), &texture.width, &texture.height, &channel, 4);
+        if (texture.cpuHandle == nullptr)
+        {
+            printf("WARNING: failed to load texture [%s]: %s, using its fill texel instead.\n", ref.name.c_str(), stbi_failure_reason());
+            texture.width = texture.height = 1;
+            texture.cpuHandle = malloc(4);
+            // masked recipes are white within the channels they keep
+            const auto texel = ref.packed || ref.keepMask == 0xFFFFFFFFU ? ref.fillTexel : ref.keepMask | (ref.fillTexel & ~ref.keepMask);
+            TextureProcessor::fillTexels(static_cast<uint8_t *>(texture.cpuHandle), texel, 1);
+            return;
         }
 
-        if (!material.reflection_texname.empty())
+        const auto texelCount = static_cast<size_t>(texture.width) * texture.height;
+        auto mergeChannel = [&](const std::string &name, uint32_t targetChannel, const char *usage)
         {
-            if (texMap.find(material.reflection_texname) == texMap.end())
+            if (auto data = loadChannel(name, usage))
             {
-                texMap[material.reflection_texname] = texContainer.size();
-                texContainer.push_back({});
-                texContainer.back().name = material.reflection_texname;
-                texContainer.back().format = VK_FORMAT_R8G8B8A8_UNORM;
-
-                int channel;
-                auto data = stbi_load((texPath / material.reflection_texname).generic_string().c_str(), &texContainer.back().width, &texContainer.back().height, &channel, 4);
-                texContainer.back().cpuHandle = new unsigned char[texContainer.back().width * texContainer.back().height * 4];
-                memcpy(texContainer.back().cpuHandle, data, texContainer.back().width * texContainer.back().height * 4);
+                TextureProcessor::insertChannel(static_cast<uint8_t *>(texture.cpuHandle), data, texelCount, targetChannel);
                 stbi_image_free(data);
             }
-            temp.properties.reflection_map_index = texMap[material.reflection_texname];
+        };
+        if (ref.packed)
+            for (auto c = 0U; c < 4; ++c)
+                if (!ref.channelNames[c].empty())
+                    mergeChannel(ref.channelNames[c], c, "channel");
+        if (!ref.alphaName.empty())
+            mergeChannel(ref.alphaName, 3, "alpha");
+        if (!ref.packed && ref.keepMask != 0xFFFFFFFFU)
+            TextureProcessor::maskTexels(static_cast<uint8_t *>(texture.cpuHandle), ref.keepMask, ref.fillTexel, texelCount);
+
+        // the chain is appended to stb_image's buffer, level 0 stays in place
+        const auto width = static_cast<uint32_t>(texture.width), height = static_cast<uint32_t>(texture.height);
+        const auto mipLevels = MipGenerator::mipLevelCount(width, height);
+        auto pixels = realloc(texture.cpuHandle, MipGenerator::mipChainSize(width, height, mipLevels));
+        if (pixels == nullptr)
+        {
+            printf("WARNING: out of memory generating mips for texture [%s], using its first level only.\n", ref.name.c_str());
+            return;
         }
+        texture.cpuHandle = pixels;
+        texture.mipLevels = mipLevels;
+        MipGenerator::generateMips(static_cast<uint8_t *>(pixels), width, height, mipLevels, ref.srgb);
 
-        matContainer.emplace_back(temp);
-    }
+        // first load: the freshly written cache entry is read back, so this run already gets the compressed texture
+        Texture compressed{};
+        if (options.compressTextures && saveTextureCache(ref, texPath, options, texture) && loadTextureCache(ref, texPath, options, compressed))
+        {
+            free(texture.cpuHandle);
+            texture = compressed;
+        }
+    };
 
-    // auto cachePath = filePath / ".cache";
-    // std::ofstream output(cachePath, std::ios::out | std::ios::binary);
-    // if (!output)
-    // {
-    //     printf("WARNING: Failed to open output cache file corresponding to loaded model [%s].\n", filePath.c_str());
-    //     output.close();
-    //     return;
-    // }
-
-    // struct sMergedMeshContainer
-    // {
-    //     std::vector<Mesh> _;
-    // } outData{meshContainer};
-    // alpaca::serialize<sMergedMeshContainer>(outData, output);
-
-    // output.close();
+    JobSystem::getInstance().parallelFor<1>(textureRefs.size(), [&](uint64_t index)
+                                            {
+                                                if (progress && progress->cancelled())
+                                                    return;
+                                                decode(textureRefs[index], textures[index]);
+                                                if (progress)
+                                                {
+                                                    progress->advance();
+                                                    if (progress->onTextureLoaded)
+                                                        progress->onTextureLoaded(static_cast<uint32_t>(index), textures[index]);
+                                                } });
 }
\ No newline at end of file
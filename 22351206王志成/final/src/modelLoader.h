@@ -1,11 +1,162 @@
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <mutex>
+
 #include <rapidobj/rapidobj.hpp>
 
 #include "mesh.hpp"
 #include "material.hpp"
 #include "texture.hpp"
 
+struct LoaderOptions
+{
+    bool interpVertexNormal{true};
+    // reorder every mesh's triangles for vertex cache reuse and its vertices for fetch locality, Mesh::acmr/atvr hold the ACMR/ATVR
+    // before & after, LoaderTimings the totals of the model
+    bool optimizeMeshes{false};
+    // partition every mesh into meshlets (Mesh::meshlets) with bounding spheres & normal cones
+    bool buildMeshlets{false};
+    // simplified levels of every mesh (Mesh::lods), Scene picks one per mesh & frame from its projected error
+    bool buildLods{false};
+    // also produce the compact GPU vertex layout (Mesh::quantizedVertices), Scene uses it once every mesh has it
+    bool quantizeVertices{false};
+    // textures are encoded once to UASTC, stored as zstd supercompressed KTX2 in the cache directory and uploaded as BC7;
+    // needs basis_universal & zstd (nvpro_core's KTX package) and a device sampling BC7
+    bool compressTextures{false};
+
+    // processed meshes/materials are stored in a binary cache keyed by source path, mtime and options
+    bool enableCache{true};
+    std::filesystem::path cacheDirectory{"cache"};
+};
+
+enum class LoaderPhase : uint32_t
+{
+    parse,
+    triangulate,
+    materials,
+    smoothNormals,
+    weld,
+    faceNormals,
+    postProcess,
+    textureDecode,
+    count
+};
+
+// time spent in every loading phase, phases running on several threads (per shape or per texture) add up their threads' time
+class LoaderTimings
+{
+public:
+    static constexpr std::array<const char *, static_cast<size_t>(LoaderPhase::count)> phaseNames{
+        "parse", "triangulate", "materials", "smooth_normals", "weld", "face_normals", "post_process", "texture_decode"};
+
+    // adds its own lifetime to the phase, does nothing without timings
+    class Scope
+    {
+    public:
+        Scope(LoaderTimings *timings, LoaderPhase phase)
+            : m_timings(timings), m_phase(phase), m_begin(timings ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{}) {}
+        ~Scope()
+        {
+            if (m_timings)
+                m_timings->add(m_phase, std::chrono::steady_clock::now() - m_begin);
+        }
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+    private:
+        LoaderTimings *m_timings{nullptr};
+        LoaderPhase m_phase{};
+        std::chrono::steady_clock::time_point m_begin{};
+    };
+
+    void add(LoaderPhase phase, std::chrono::nanoseconds duration) { m_nanoseconds[static_cast<size_t>(phase)] += duration.count(); }
+    double seconds(LoaderPhase phase) const { return m_nanoseconds[static_cast<size_t>(phase)].load() * 1e-9; }
+
+    // vertex cache statistics of the optimized meshes, transformed counts are simulated before & after optimizing
+    void addVertexCache(uint64_t triangles, uint64_t vertices, uint64_t transformedBefore, uint64_t transformedAfter)
+    {
+        m_cacheTriangles += triangles;
+        m_cacheVertices += vertices;
+        m_transformed[0] += transformedBefore;
+        m_transformed[1] += transformedAfter;
+    }
+    // over all optimized meshes, 0 when none was
+    double acmr(bool optimized) const { return m_cacheTriangles == 0 ? 0. : static_cast<double>(m_transformed[optimized].load()) / m_cacheTriangles.load(); }
+    double atvr(bool optimized) const { return m_cacheVertices == 0 ? 0. : static_cast<double>(m_transformed[optimized].load()) / m_cacheVertices.load(); }
+
+private:
+    std::array<std::atomic_int64_t, static_cast<size_t>(LoaderPhase::count)> m_nanoseconds{};
+    std::atomic_uint64_t m_cacheTriangles{0ULL};
+    std::atomic_uint64_t m_cacheVertices{0ULL};
+    std::array<std::atomic_uint64_t, 2> m_transformed{};
+};
+
+// shared between a background load and the render thread, every method is thread-safe
+class LoadingProgress
+{
+public:
+    void cancel() { m_cancelled = true; }
+    bool cancelled() const { return m_cancelled; }
+    bool finished() const { return m_finished; }
+    const LoaderTimings &timings() const { return m_timings; }
+
+    // fraction of finished work items (parsing, meshes and textures) in [0, 1]
+    float progress() const
+    {
+        const auto total = m_totalWork.load();
+        return total == 0 ? 0.f : static_cast<float>(m_finishedWork.load()) / total;
+    }
+    std::string stage() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_stage;
+    }
+    std::string error() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_error;
+    }
+
+    // streaming hooks, invoked on loader threads as soon as each item is ready
+    // materials always arrive first, indices in meshes and materials are relative to this model
+    std::function<void(const std::vector<Material> &materials, size_t textureCount)> onMaterialsLoaded{};
+    std::function<void(uint32_t meshIndex, const Mesh &mesh)> onMeshLoaded{};
+    // the hook may take over texture.cpuHandle, leaving nullptr behind
+    std::function<void(uint32_t textureIndex, Texture &texture)> onTextureLoaded{};
+
+private:
+    friend class ModelLoader;
+
+    void setStage(const std::string &stage)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stage = stage;
+    }
+    void setError(const std::string &error)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_error = error;
+    }
+    void addWork(uint32_t count) { m_totalWork += count; }
+    void advance() { m_finishedWork++; }
+
+    std::atomic_uint32_t m_finishedWork{0U};
+    std::atomic_uint32_t m_totalWork{0U};
+    std::atomic_bool m_cancelled{false};
+    std::atomic_bool m_finished{false};
+    LoaderTimings m_timings{};
+
+    mutable std::mutex m_mutex{};
+    std::string m_stage{""};
+    std::string m_error{""};
+};
+
 class ModelLoader
 {
 public:
@@ -20,31 +171,134 @@ public:
         return instance;
     }
 
+    // appends the model to the containers, rebasing its material & texture indices onto their current sizes
     void load(std::vector<Mesh> &meshContainer, std::vector<Material> &matContainer, std::vector<Texture> &texContainer,
               const std::filesystem::path &filePath, const std::filesystem::path &texPath, const std::filesystem::path &materialPath = "",
-              bool interpVertexNormal = true)
+              const LoaderOptions &options = {})
     {
-        // if (!loadCache(meshContainer, matContainer, texContainer, filePath))
-        fullyReload(meshContainer, matContainer, texContainer, filePath, texPath, materialPath, interpVertexNormal);
+        std::vector<Mesh> meshes{};
+        std::vector<Material> materials{};
+        std::vector<Texture> textures{};
+        loadModel(meshes, materials, textures, filePath, texPath, materialPath, options, nullptr);
+
+        for (auto &mesh : meshes)
+            mesh.offsetMaterialIndices(static_cast<uint32_t>(matContainer.size()));
+        for (auto &material : materials)
+            material.offsetTextureIndices(static_cast<uint32_t>(texContainer.size()));
+        meshContainer.insert(meshContainer.end(), std::make_move_iterator(meshes.begin()), std::make_move_iterator(meshes.end()));
+        matContainer.insert(matContainer.end(), materials.begin(), materials.end());
+        texContainer.insert(texContainer.end(), textures.begin(), textures.end());
     }
-    auto load(const std::filesystem::path &filePath, const std::filesystem::path &texPath, const std::filesystem::path &materialPath = "", bool interpVertexNormal = true)
+    auto load(const std::filesystem::path &filePath, const std::filesystem::path &texPath, const std::filesystem::path &materialPath = "", const LoaderOptions &options = {})
         -> std::tuple<std::vector<Mesh>, std::vector<Material>, std::vector<Texture>>
     {
         std::vector<Mesh> resMesh{};
         std::vector<Material> resMat{};
         std::vector<Texture> resTex{};
-        load(resMesh, resMat, resTex, filePath, texPath, materialPath, interpVertexNormal);
+        load(resMesh, resMat, resTex, filePath, texPath, materialPath, options);
         return std::tuple{resMesh, resMat, resTex};
     }
 
+    // loads on a background thread, streaming results through progress' hooks
+    // the future throws if loading failed, cancellation is not an error
+    std::future<void> loadAsync(std::shared_ptr<LoadingProgress> progress,
+                                const std::filesystem::path &filePath, const std::filesystem::path &texPath, const std::filesystem::path &materialPath = "",
+                                const LoaderOptions &options = {})
+    {
+        return std::async(std::launch::async, [=, this]()
+                          {
+                              std::vector<Mesh> meshes{};
+                              std::vector<Material> materials{};
+                              std::vector<Texture> textures{};
+                              // textures the hook did not take over are released here, whether loading failed or not
+                              auto freeTextures = [&]()
+                              {
+                                  for (auto &texture : textures)
+                                      free(texture.cpuHandle);
+                              };
+                              try
+                              {
+                                  loadModel(meshes, materials, textures, filePath, texPath, materialPath, options, progress.get());
+                              }
+                              catch (const std::exception &e)
+                              {
+                                  freeTextures();
+                                  progress->setError(e.what());
+                                  progress->m_finished = true;
+                                  throw;
+                              }
+                              freeTextures();
+                              progress->m_finished = true; });
+    }
+
+    // tangent space (0, 0, 1), the fill of normal & bump maps
+    static constexpr uint32_t flatNormalTexel = 0xFFFF8080U;
+
 private:
     ModelLoader() {}
     ~ModelLoader() {}
 
-    // bool loadCache(std::vector<Mesh> &meshContainer, std::vector<Material> &matContainer, std::vector<Texture> &texContainer, const std::filesystem::path &filePath);
+    // texture referenced by materials, decoded after all materials are converted
+    // multi-channel images merged into a single channel contribute their luminance
+    struct sTextureRef
+    {
+        std::string name{""};
+        std::string alphaName{""}; // merged into the alpha channel of the decoded texture
+        bool srgb{true};           // color data, its mips are filtered in linear space
+        // > 0: name is a bump map, converted to a normal map with bumps of this height in texels
+        float bumpScale{0.f};
+        // packed textures are assembled from one image per channel instead of name, channels without one keep fillTexel's
+        bool packed{false};
+        std::array<std::string, 4> channelNames{};
+        // decoded images only keep the channels in keepMask, the others are taken from fillTexel (little endian RGBA)
+        // when nothing is masked, fillTexel is what an image that fails to load is replaced with
+        uint32_t keepMask{0xFFFFFFFFU};
+        uint32_t fillTexel{0xFFFFFFFFU};
+        // encoded image already in memory (embedded glTF images), decoded instead of the file; never cached
+        const uint8_t *encoded{nullptr};
+        size_t encodedSize{0ULL};
+    };
+
+    // fills empty containers with the model, indices are local to it; progress may be nullptr
+    void loadModel(std::vector<Mesh> &meshContainer, std::vector<Material> &matContainer, std::vector<Texture> &texContainer,
+                   const std::filesystem::path &filePath, const std::filesystem::path &texPath, const std::filesystem::path &materialPath,
+                   const LoaderOptions &options, LoadingProgress *progress)
+    {
+        if (progress)
+            progress->setStage("loading " + filePath.filename().generic_string());
+        // glTF is already indexed, converting it is cheaper than reading a cache
+        if (isGltf(filePath))
+            loadGltf(meshContainer, matContainer, texContainer, filePath, options, progress);
+        else if (!options.enableCache || !loadCache(meshContainer, matContainer, texContainer, filePath, texPath, materialPath, options, progress))
+            fullyReload(meshContainer, matContainer, texContainer, filePath, texPath, materialPath, options, progress);
+    }
     void fullyReload(std::vector<Mesh> &meshContainer, std::vector<Material> &matContainer, std::vector<Texture> &texContainer,
-                     const std::filesystem::path &filePath, const std::filesystem::path &texPath, const std::filesystem::path &materialPath = "",
-                     bool interpVertexNormal = true);
+                     const std::filesystem::path &filePath, const std::filesystem::path &texPath, const std::filesystem::path &materialPath,
+                     const LoaderOptions &options, LoadingProgress *progress);
+    // steps shared by every format once a mesh is converted & welded: optimization, meshlets, LODs then quantization
+    static void postProcessMesh(Mesh &mesh, const LoaderOptions &options, LoaderTimings *timings);
+    static LoaderTimings *getTimings(LoadingProgress *progress) { return progress ? &progress->m_timings : nullptr; }
+    // decodes textureRefs[i] into textures[i] on a pool of worker threads
+    void decodeTextures(const std::vector<sTextureRef> &textureRefs, std::vector<Texture> &textures, const std::filesystem::path &texPath,
+                        const LoaderOptions &options, LoadingProgress *progress);
+
+    // implemented in gltfLoader.cpp
+    static bool isGltf(const std::filesystem::path &filePath);
+    void loadGltf(std::vector<Mesh> &meshContainer, std::vector<Material> &matContainer, std::vector<Texture> &texContainer,
+                  const std::filesystem::path &filePath, const LoaderOptions &options, LoadingProgress *progress);
+
+    // implemented in textureCache.cpp
+    static std::string makeTextureCacheKey(const sTextureRef &ref, const std::filesystem::path &texPath);
+    bool loadTextureCache(const sTextureRef &ref, const std::filesystem::path &texPath, const LoaderOptions &options, Texture &texture);
+    bool saveTextureCache(const sTextureRef &ref, const std::filesystem::path &texPath, const LoaderOptions &options, const Texture &texture);
+
+    // implemented in modelCache.cpp
+    bool loadCache(std::vector<Mesh> &meshContainer, std::vector<Material> &matContainer, std::vector<Texture> &texContainer,
+                   const std::filesystem::path &filePath, const std::filesystem::path &texPath, const std::filesystem::path &materialPath,
+                   const LoaderOptions &options, LoadingProgress *progress);
+    void saveCache(const std::vector<Mesh> &meshContainer, const std::vector<Material> &matContainer, const std::vector<sTextureRef> &textureRefs,
+                   const std::filesystem::path &filePath, const std::filesystem::path &texPath, const std::filesystem::path &materialPath,
+                   const LoaderOptions &options);
 
     struct sMeshTask
     {
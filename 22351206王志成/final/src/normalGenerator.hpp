@@ -0,0 +1,126 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <vector>
+
+#include "jobSystem.hpp"
+#include <nvmath/nvmath.h>
+
+#include "utils.hpp"
+
+/* per-corner smooth normals of a triangle list, following OBJ smoothing groups */
+// corners sharing a position and a non-zero smoothing group get the angle-weighted average of their faces' normals,
+// corners of group 0 keep their face normal
+//   1. compute every corner's weighted face normal
+//   2. bucket the smoothed corners by position index with a counting sort into CSR arrays (offsets + corner list)
+//   3. accumulate each bucket per smoothing group, buckets are independent so this runs in parallel
+// every corner lives in exactly one bucket, so contributions are accumulated in place in normals
+// getPositionIndex(corner) indexes xyz triplets in positions, corners 3f..3f+2 form face f
+template <typename PositionIndexFunc>
+void generateSmoothNormals(size_t cornerCount, PositionIndexFunc &&getPositionIndex, const float *positions, const uint32_t *smoothingGroups,
+                           std::vector<nvmath::vec3f> &normals, uint32_t numThreads)
+{
+    const auto faceCount = cornerCount / 3;
+    normals.resize(faceCount * 3);
+    if (faceCount == 0)
+        return;
+
+    auto getPosition = [&](size_t corner)
+    {
+        const auto index = static_cast<size_t>(getPositionIndex(corner)) * 3;
+        return nvmath::vec3f(positions[index + 0], positions[index + 1], positions[index + 2]);
+    };
+
+    // weighted contribution of every smoothed corner, degenerated faces contribute nothing
+    std::vector<uint32_t> minPosition(numThreads, ~0U), maxPosition(numThreads, 0U);
+    JobSystem::getInstance().parallelRanges<4096>(faceCount, [&](uint64_t faceBegin, uint64_t faceEnd, uint32_t threadIdx)
+                                                  {
+                                                      for (auto f = faceBegin; f < faceEnd; ++f)
+                                                      {
+                                                          const auto p0 = getPosition(3 * f + 0), p1 = getPosition(3 * f + 1), p2 = getPosition(3 * f + 2);
+                                                          auto faceNormal = nvmath::cross(p1 - p0, p2 - p0);
+                                                          const auto length = nvmath::length(faceNormal);
+                                                          faceNormal = length > 0.f ? faceNormal / length : nvmath::vec3f_zero;
+                                                          if (smoothingGroups[f] == 0)
+                                                              normals[3 * f + 0] = normals[3 * f + 1] = normals[3 * f + 2] = faceNormal;
+                                                          else
+                                                          {
+                                                              // corner i lies between edge i and the reversed edge i + 2
+                                                              nvmath::vec3f edges[3]{p1 - p0, p2 - p1, p0 - p2};
+                                                              for (auto &edge : edges)
+                                                              {
+                                                                  const auto edgeLength = nvmath::length(edge);
+                                                                  edge = edgeLength > 0.f ? edge / edgeLength : nvmath::vec3f_zero;
+                                                              }
+                                                              for (auto i = 0; i < 3; ++i)
+                                                                  normals[3 * f + i] = faceNormal * std::acos(std::clamp(-nvmath::dot(edges[i], edges[(i + 2) % 3]), -1.f, 1.f));
+                                                          }
+                                                          for (auto corner = 3 * f; corner < 3 * f + 3; ++corner)
+                                                          {
+                                                              const auto position = static_cast<uint32_t>(getPositionIndex(corner));
+                                                              minPosition[threadIdx] = std::min(minPosition[threadIdx], position);
+                                                              maxPosition[threadIdx] = std::max(maxPosition[threadIdx], position);
+                                                          }
+                                                      } }, numThreads);
+
+    const auto positionBegin = *std::min_element(minPosition.begin(), minPosition.end());
+    const auto positionCount = static_cast<size_t>(*std::max_element(maxPosition.begin(), maxPosition.end())) - positionBegin + 1;
+
+    // uncontended atomics still cost a locked instruction, skip them when running serially
+    auto fetchAdd = [numThreads](uint32_t &value)
+    { return numThreads > 1 ? std::atomic_ref<uint32_t>(value).fetch_add(1U, std::memory_order_relaxed) : value++; };
+
+    // CSR: corners of bucket p are bucketCorners[offsets[p], offsets[p + 1])
+    std::vector<uint32_t> offsets(positionCount + 1, 0U);
+    JobSystem::getInstance().parallelRanges<4096>(faceCount * 3, [&](uint64_t cornerBegin, uint64_t cornerEnd, uint32_t)
+                                                  {
+                                                      for (auto c = cornerBegin; c < cornerEnd; ++c)
+                                                          if (smoothingGroups[c / 3] != 0)
+                                                              fetchAdd(offsets[getPositionIndex(c) - positionBegin + 1]);
+                                                  }, numThreads);
+    for (auto p = 0ULL; p < positionCount; ++p)
+        offsets[p + 1] += offsets[p];
+
+    std::vector<uint32_t> cursors(offsets.begin(), offsets.end() - 1);
+    std::vector<uint32_t> bucketCorners(offsets.back());
+    JobSystem::getInstance().parallelRanges<4096>(faceCount * 3, [&](uint64_t cornerBegin, uint64_t cornerEnd, uint32_t)
+                                                  {
+                                                      for (auto c = cornerBegin; c < cornerEnd; ++c)
+                                                          if (smoothingGroups[c / 3] != 0)
+                                                              bucketCorners[fetchAdd(cursors[getPositionIndex(c) - positionBegin])] = static_cast<uint32_t>(c);
+                                                  }, numThreads);
+    cursors = {};
+
+    JobSystem::getInstance().parallelRanges<1024>(positionCount, [&](uint64_t rangeBegin, uint64_t rangeEnd, uint32_t)
+                                                  {
+                                                      for (auto p = rangeBegin; p < rangeEnd; ++p)
+                                                      {
+                                                          // concurrent scattering leaves buckets unordered, sorting by (group, corner) makes the sums
+                                                          // deterministic and puts every smoothing group into one contiguous run
+                                                          const auto begin = bucketCorners.begin() + offsets[p];
+                                                          const auto end = bucketCorners.begin() + offsets[p + 1];
+                                                          auto less = [&](uint32_t a, uint32_t b)
+                                                          { return smoothingGroups[a / 3] != smoothingGroups[b / 3] ? smoothingGroups[a / 3] < smoothingGroups[b / 3] : a < b; };
+                                                          // buckets are small and mostly sorted already, insertion sort is linear then
+                                                          if (end - begin > 32)
+                                                              std::sort(begin, end, less);
+                                                          else
+                                                              for (auto i = begin + 1; i < end; ++i)
+                                                                  for (auto j = i; j != begin && less(*j, *(j - 1)); --j)
+                                                                      std::iter_swap(j, j - 1);
+
+                                                          for (auto run = begin; run != end;)
+                                                          {
+                                                              const auto group = smoothingGroups[*run / 3];
+                                                              auto runEnd = run;
+                                                              auto sum = nvmath::vec3f_zero;
+                                                              for (; runEnd != end && smoothingGroups[*runEnd / 3] == group; ++runEnd)
+                                                                  sum += normals[*runEnd];
+                                                              const auto length = nvmath::length(sum);
+                                                              for (; run != runEnd; ++run)
+                                                                  normals[*run] = length > 0.f ? sum / length : nvmath::vec3f_zero;
+                                                          }
+                                                      } }, numThreads);
+}
\ No newline at end of file
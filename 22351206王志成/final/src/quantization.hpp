@@ -0,0 +1,66 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include "utils.hpp"
+
+/* helpers for the compact vertex format, decoded by include/packing.glsl */
+
+// IEEE half float, rounded to nearest, matches GLSL's unpackHalf2x16
+inline uint16_t packHalf(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    const auto sign = static_cast<uint16_t>((bits >> 16) & 0x8000U);
+    const auto biasedExponent = static_cast<int32_t>((bits >> 23) & 0xFFU);
+    const auto exponent = biasedExponent - 127 + 15;
+    auto mantissa = bits & 0x7FFFFFU;
+
+    // inf & nan keep their class
+    if (biasedExponent == 0xFF)
+        return sign | 0x7C00U | (mantissa ? 0x200U : 0U);
+    if (exponent >= 31)
+        return sign | 0x7C00U;
+    // subnormal halves, values too small flush to zero
+    if (exponent <= 0)
+    {
+        if (exponent < -10)
+            return sign;
+        mantissa |= 0x800000U;
+        const auto shift = 14 - exponent;
+        auto half = mantissa >> shift;
+        if ((mantissa >> (shift - 1)) & 1U)
+            ++half;
+        return static_cast<uint16_t>(sign | half);
+    }
+    // a rounding carry into the exponent still gives the correct (next) value
+    auto half = static_cast<uint32_t>(sign) | (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+    if (mantissa & 0x1000U)
+        ++half;
+    return static_cast<uint16_t>(half);
+}
+
+inline int16_t packSnorm16(float value)
+{
+    return static_cast<int16_t>(std::round(std::clamp(value, -1.f, 1.f) * 32767.f));
+}
+
+inline uint16_t packUnorm16(float value)
+{
+    return static_cast<uint16_t>(std::round(std::clamp(value, 0.f, 1.f) * 65535.f));
+}
+
+// octahedral mapping of a unit vector onto [-1, 1]^2, the lower hemisphere is folded over the diagonals
+inline nvmath::vec2f encodeOctahedral(const nvmath::vec3f &normal)
+{
+    const auto l1Norm = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+    if (l1Norm == 0.f)
+        return {0.f, 0.f};
+    nvmath::vec2f res{normal.x / l1Norm, normal.y / l1Norm};
+    if (normal.z < 0.f)
+        res = {(1.f - std::abs(res.y)) * (res.x >= 0.f ? 1.f : -1.f), (1.f - std::abs(res.x)) * (res.y >= 0.f ? 1.f : -1.f)};
+    return res;
+}
\ No newline at end of file
@@ -1,5 +1,9 @@
 #pragma once
 
+#include <chrono>
+#include <mutex>
+#include <unordered_map>
+
 #include <nvvk/commands_vk.hpp>
 #include <nvvk/memallocator_vma_vk.hpp>
 #include <nvvk/descriptorsets_vk.hpp>
@@ -9,6 +13,9 @@
 #include "mesh.hpp"
 #include "material.hpp"
 #include "texture.hpp"
+#include "textureStreamer.hpp"
+#include "geometryHeap.hpp"
+#include "transferUploader.hpp"
 
 class Application;
 
@@ -47,21 +54,108 @@ public:
 
     void addObjectGroup(const objectGroup &group)
     {
+        for (auto i = 0U; i < group.size(); ++i)
+            m_unuploadedMeshes.push_back({static_cast<uint32_t>(m_objects.size()), i});
         m_objects.emplace_back(group);
         m_dirty = true;
     }
 
-    void addTexture(const Texture &texture) { m_textures.emplace_back(texture); }
+    // releases the group's geometry once the frames in flight are done with it, the group index stays valid (and empty)
+    // its materials & textures are kept, as the other groups refer to theirs by position
+    void removeObjectGroup(uint32_t groupIndex)
+    {
+        const auto allFrames = (1U << std::max(m_textureSetFrameCount, 1U)) - 1U;
+        for (const auto &draw : m_meshDraws)
+            if (draw.groupIndex == groupIndex)
+            {
+                m_vertexHeap.free(draw.vertexOffset, allFrames);
+                m_boundsHeap.free(draw.boundsSlot, allFrames);
+                m_meshHeap.free(draw.meshSlot, allFrames);
+                if (draw.meshletCount > 0U)
+                    m_meshletHeap.free(draw.meshletOffset, allFrames);
+                m_triangleHeap.free(draw.triangleOffset, allFrames);
+            }
+        std::erase_if(m_meshDraws, [&](const sMeshDraw &draw)
+                      { return draw.groupIndex == groupIndex; });
+        std::erase_if(m_unuploadedMeshes, [&](const sMeshRef &mesh)
+                      { return mesh.groupIndex == groupIndex; });
+        m_objects[groupIndex].clear();
+        m_instancesDirty = true;
+    }
 
-    void addMaterial(const Material &material) { m_materials.emplace_back(material); }
+    // places the group's meshes once more, meshes streamed into the group later are placed as well
+    uint32_t addInstance(uint32_t groupIndex, const nvmath::mat4f &transform)
+    {
+        m_instances.push_back({groupIndex, transform});
+        m_instancesDirty = true;
+        return static_cast<uint32_t>(m_instances.size() - 1);
+    }
+    // only the instance's rows are patched & re-uploaded, the geometry stays untouched
+    void setInstanceTransform(uint32_t instance, const nvmath::mat4f &transform)
+    {
+        auto &placed = m_instances[instance];
+        placed.transform = transform;
+        // a pending rebuild picks the transform up anyway
+        if (m_instancesDirty)
+            return;
+        const auto normalTransform = nvmath::transpose(nvmath::invert(transform));
+        for (auto row = placed.firstRow; row < placed.firstRow + placed.rowCount; ++row)
+        {
+            m_instanceRows[row].transform = transform;
+            m_instanceRows[row].normalTransform = normalTransform;
+        }
+        if (placed.rowCount > 0U && !placed.rowsDirty)
+        {
+            placed.rowsDirty = true;
+            m_dirtyInstances.push_back(instance);
+        }
+    }
+    const nvmath::mat4f &getInstanceTransform(uint32_t instance) const { return m_instances[instance].transform; }
 
-    void prepareToDraw()
+    void addTexture(const Texture &texture)
     {
+        m_textures.emplace_back(texture);
+        m_texturesDirty = true;
+    }
+
+    void addMaterial(const Material &material)
+    {
+        m_materials.emplace_back(material);
+        m_dirty = true;
+    }
+
+    // thread-safe entry points for background loading, updates are applied by prepareToDraw on the render thread
+    // indices in streamed meshes & materials are relative to their model, materials must be streamed before anything else of the model
+    void streamMaterials(uint32_t groupIndex, const std::vector<Material> &materials, size_t textureCount)
+    {
+        sPendingMaterials pending{groupIndex, materials, textureCount};
+        std::lock_guard<std::mutex> lock(m_pendingMutex);
+        m_pendingMaterials.emplace_back(std::move(pending));
+    }
+    void streamMesh(uint32_t groupIndex, const Mesh &mesh)
+    {
+        sPendingMesh pending{groupIndex, mesh};
+        std::lock_guard<std::mutex> lock(m_pendingMutex);
+        m_pendingMeshes.emplace_back(std::move(pending));
+    }
+    // takes over texture.cpuHandle
+    void streamTexture(uint32_t groupIndex, uint32_t textureIndex, Texture &texture)
+    {
+        sPendingTexture pending{groupIndex, textureIndex, texture};
+        texture.cpuHandle = nullptr;
+        std::lock_guard<std::mutex> lock(m_pendingMutex);
+        m_pendingTextures.emplace_back(std::move(pending));
+    }
+
+    // frameIndex is the swapchain image being recorded, its previous submission must have completed
+    // uploads are submitted to the transfer queue without waiting, cmdAcquireUploads makes them visible to the frame
+    void prepareToDraw(uint32_t frameIndex = 0U)
+    {
+        m_uploader.collect();
         if (!m_descPool)
         {
             std::vector<VkDescriptorPoolSize> poolSizes{};
-            poolSizes.push_back({VkDescriptorType::VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 8U});
-            poolSizes.push_back({VkDescriptorType::VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 64U});
+            poolSizes.push_back({VkDescriptorType::VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 16U});
             VkDescriptorPoolCreateInfo createInfo = nvvk::make<VkDescriptorPoolCreateInfo>();
             createInfo.flags = VkDescriptorPoolCreateFlagBits::VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
             createInfo.maxSets = 4U;
@@ -75,122 +169,303 @@ public:
             m_geometryBinding.addBinding(1, VkDescriptorType::VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
             m_geometryBinding.addBinding(2, VkDescriptorType::VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
             m_geometryBinding.addBinding(3, VkDescriptorType::VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
+            m_geometryBinding.addBinding(4, VkDescriptorType::VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
+            m_geometryBinding.addBinding(5, VkDescriptorType::VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
+            m_geometryBinding.addBinding(6, VkDescriptorType::VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
+            m_geometryBinding.addBinding(7, VkDescriptorType::VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
+            m_geometryBinding.addBinding(8, VkDescriptorType::VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
+            m_geometryBinding.addBinding(9, VkDescriptorType::VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
+            m_geometryBinding.addBinding(10, VkDescriptorType::VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
+            m_geometryBinding.addBinding(11, VkDescriptorType::VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
+            m_geometryBinding.addBinding(12, VkDescriptorType::VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
             m_geometryBinding.setBindingFlags(0, VkDescriptorBindingFlagBits::VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT);
             m_geometryBinding.setBindingFlags(1, VkDescriptorBindingFlagBits::VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT);
             m_geometryBinding.setBindingFlags(2, VkDescriptorBindingFlagBits::VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT);
             m_geometryBinding.setBindingFlags(3, VkDescriptorBindingFlagBits::VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT);
+            m_geometryBinding.setBindingFlags(4, VkDescriptorBindingFlagBits::VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT);
+            m_geometryBinding.setBindingFlags(5, VkDescriptorBindingFlagBits::VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT);
+            m_geometryBinding.setBindingFlags(6, VkDescriptorBindingFlagBits::VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT);
+            m_geometryBinding.setBindingFlags(7, VkDescriptorBindingFlagBits::VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT);
+            m_geometryBinding.setBindingFlags(8, VkDescriptorBindingFlagBits::VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT);
+            m_geometryBinding.setBindingFlags(9, VkDescriptorBindingFlagBits::VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT);
+            m_geometryBinding.setBindingFlags(10, VkDescriptorBindingFlagBits::VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT);
+            m_geometryBinding.setBindingFlags(11, VkDescriptorBindingFlagBits::VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT);
+            m_geometryBinding.setBindingFlags(12, VkDescriptorBindingFlagBits::VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT);
 
             m_geometrySetLayout = m_geometryBinding.createLayout(m_deviceHandle, VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT, nvvk::DescriptorSupport::CORE_1_2);
             m_geometrySet = nvvk::allocateDescriptorSet(m_deviceHandle, m_descPool, m_geometrySetLayout);
         }
         if (m_textureBinding.empty())
         {
-            const uint32_t textureSetMaxVariableCount = 32;
-            m_textureBinding.addBinding(0, VkDescriptorType::VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, textureSetMaxVariableCount, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
-            m_textureBinding.setBindingFlags(0, VkDescriptorBindingFlagBits::VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VkDescriptorBindingFlagBits::VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT | VkDescriptorBindingFlagBits::VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT);
+            // the layout declares the most the device allows, sets are allocated with their current capacity only
+            m_textureSetLimit = std::clamp(m_textureSetLimit, initialTextureSetCapacity + reservedSamplerCount, textureSetHardLimit + reservedSamplerCount) - reservedSamplerCount;
+            // binding 0 is the streaming feedback, the variable sized texture array has to be the last binding
+            m_textureBinding.addBinding(0, VkDescriptorType::VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
+            m_textureBinding.addBinding(1, VkDescriptorType::VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, m_textureSetLimit, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
+            m_textureBinding.setBindingFlags(0, VkDescriptorBindingFlagBits::VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT);
+            m_textureBinding.setBindingFlags(1, VkDescriptorBindingFlagBits::VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VkDescriptorBindingFlagBits::VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT | VkDescriptorBindingFlagBits::VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT);
 
             m_textureSetLayout = m_textureBinding.createLayout(m_deviceHandle, VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT, nvvk::DescriptorSupport::INDEXING_EXT);
-
-            VkDescriptorSetAllocateInfo allocInfo = nvvk::make<VkDescriptorSetAllocateInfo>();
-            allocInfo.descriptorPool = m_descPool;
-            allocInfo.descriptorSetCount = 1;
-            allocInfo.pSetLayouts = &m_textureSetLayout;
-            VkDescriptorSetVariableDescriptorCountAllocateInfo variableInfo = nvvk::make<VkDescriptorSetVariableDescriptorCountAllocateInfo>();
-            variableInfo.descriptorSetCount = 1;
-            variableInfo.pDescriptorCounts = &textureSetMaxVariableCount;
-            allocInfo.pNext = &variableInfo;
-            NVVK_CHECK(vkAllocateDescriptorSets(m_deviceHandle, &allocInfo, &m_textureSet));
         }
 
-        if (!m_dirty)
-            return;
-
-        m_allocatorHandle.destroy(m_vertexBuffer);
-        m_allocatorHandle.destroy(m_triangleBuffer);
-        m_allocatorHandle.destroy(m_materialBuffer);
-        m_allocatorHandle.destroy(m_indexBuffer);
+        applyPendingUpdates();
+        if (m_texturesDirty)
+            updateTextures();
+        streamTextures(frameIndex);
+        readDrawCounts(frameIndex);
+        updateTextureSet(frameIndex);
 
-        std::vector<VertexAttribute> totalVertexData{};
-        std::vector<FaceAttribute> totalTriangleData{};
-        std::vector<MaterialAttribute> totalMaterialData{};
-        std::vector<uint32_t> totalIndexData{};
+        updateGeometry(frameIndex);
+        if (m_instancesDirty)
+            updateInstances();
+        m_uploader.submit();
+    }
 
-        auto offset = 0U;
-        for (const auto &group : m_objects)
+    // records, before anything reads the scene, the queue ownership acquires of the uploads submitted so far
+    // the frame's submission has to wait for m_uploader's semaphore, see Application::submitFrame
+    void cmdAcquireUploads(VkCommandBuffer cmdBuf)
+    {
+        m_uploader.cmdAcquire(cmdBuf);
+        if (m_feedbackNeedsClear)
         {
-            for (const auto &object : group)
-            {
-                totalVertexData.insert(totalVertexData.end(), object.vertices.begin(), object.vertices.end());
-                totalTriangleData.insert(totalTriangleData.end(), object.faces.begin(), object.faces.end());
-                auto beginIndex = totalIndexData.size();
-                totalIndexData.insert(totalIndexData.end(), object.indices.begin(), object.indices.end());
-                std::for_each(totalIndexData.begin() + beginIndex, totalIndexData.end(), [&](uint32_t &elem)
-                              { elem += offset; });
-                offset = totalVertexData.size();
-            }
+            vkCmdFillBuffer(cmdBuf, m_feedbackBuffer.buffer, 0, VK_WHOLE_SIZE, 0U);
+            VkMemoryBarrier barrier = nvvk::make<VkMemoryBarrier>();
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+            vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+            m_feedbackNeedsClear = false;
         }
-        m_totalVertexCount = totalTriangleData.size() * 3;
-        totalMaterialData.reserve(m_materials.size());
-        for (const auto &material : m_materials)
-            totalMaterialData.emplace_back(material.properties);
+    }
+
+    // true when there is geometry to draw
+    bool resident() const { return m_geometryBound && !m_instanceRows.empty(); }
+    VkBuffer indexBuffer() const { return m_triangleHeap.buffer(1).buffer; }
 
+    VkBuffer drawBuffer() const { return m_drawBuffer.buffer; }
+    VkBuffer drawCountBuffer() const { return m_drawCountBuffer.buffer; }
+    uint32_t instanceRowCount() const { return static_cast<uint32_t>(m_instanceRows.size()); }
+    // upper bound of a culling phase's draws: one per row, plus one per meshlet of the rows expanded to their meshlets
+    uint32_t maxDrawCount() const { return m_maxDrawCount; }
+    // the meshlet pass is dispatched indirectly, one workgroup per row the instance pass expanded
+    VkDeviceSize clusterDispatchOffset() const { return 4 * sizeof(uint32_t); }
+    // counts of both culling phases, a few frames late
+    uint32_t drawnInstanceCount() const { return m_drawCounts[1]; }
+    uint32_t culledInstanceCount() const { return m_drawCounts[2]; }
+    uint32_t occludedInstanceCount() const { return m_drawCounts[3]; }
+    uint32_t drawnMeshletCount() const { return m_drawCounts[7]; }
+    uint32_t culledMeshletCount() const { return m_drawCounts[8]; }
+    uint32_t occludedMeshletCount() const { return m_drawCounts[9]; }
+
+    // records the reset of the draw & job counts before a culling phase, which waits for the draws of the previous one
+    // the totals are only reset by the frame's first phase
+    void cmdBeginCulling(VkCommandBuffer cmdBuf, bool resetTotals)
+    {
+        vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+        if (resetTotals)
+        {
+            // the dispatch's y & z stay 1
+            uint32_t counts[std::size(m_drawCounts)]{};
+            counts[5] = counts[6] = 1U;
+            vkCmdUpdateBuffer(cmdBuf, m_drawCountBuffer.buffer, 0, sizeof(counts), counts);
+        }
+        else
         {
-            nvvk::ScopeCommandBuffer scopedBuffer(m_deviceHandle, m_transferQueueFamilyIndex, m_transferQueue);
+            vkCmdFillBuffer(cmdBuf, m_drawCountBuffer.buffer, 0, sizeof(uint32_t), 0U);
+            vkCmdFillBuffer(cmdBuf, m_drawCountBuffer.buffer, clusterDispatchOffset(), sizeof(uint32_t), 0U);
+        }
+        VkMemoryBarrier barrier = nvvk::make<VkMemoryBarrier>();
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+
+    // records the barrier between the instance pass of a culling phase and its meshlet pass, dispatched from the job count
+    void cmdCullingBarrier(VkCommandBuffer cmdBuf)
+    {
+        VkMemoryBarrier barrier = nvvk::make<VkMemoryBarrier>();
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
 
-            m_vertexBuffer = m_allocatorHandle.createBuffer(scopedBuffer, totalVertexData, VkBufferUsageFlagBits::VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VkBufferUsageFlagBits::VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
-            m_triangleBuffer = m_allocatorHandle.createBuffer(scopedBuffer, totalTriangleData, VkBufferUsageFlagBits::VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
-            m_materialBuffer = m_allocatorHandle.createBuffer(scopedBuffer, totalMaterialData, VkBufferUsageFlagBits::VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
-            m_indexBuffer = m_allocatorHandle.createBuffer(scopedBuffer, totalIndexData, VkBufferUsageFlagBits::VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VkBufferUsageFlagBits::VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    // records the barrier between a culling phase and the indirect draws consuming its output,
+    // the visibility flags it wrote are read by the next phase
+    void cmdEndCulling(VkCommandBuffer cmdBuf)
+    {
+        VkMemoryBarrier barrier = nvvk::make<VkMemoryBarrier>();
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+        vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             0, 1, &barrier, 0, nullptr, 0, nullptr);
+        m_drawCountsCulled = true;
+    }
 
-            for (auto &texture : m_textures)
-                if (texture.gpuHandle.memHandle == nullptr)
-                    texture.gpuHandle = m_allocatorHandle.createTexture(scopedBuffer, texture.width * texture.height * 4, texture.cpuHandle,
-                                                                        nvvk::makeImage2DCreateInfo({static_cast<uint32_t>(texture.width), static_cast<uint32_t>(texture.height)}, texture.format),
-                                                                        nvvk::makeSamplerCreateInfo());
+    // records the copy of this frame's draw counts for the CPU, read when the frame comes round again
+    void cmdResolveDrawCounts(VkCommandBuffer cmdBuf, uint32_t frameIndex)
+    {
+        if (frameIndex >= m_drawCountReadbacks.size())
+            return;
+        m_drawCountsResolved[frameIndex] = m_drawCountsCulled;
+        if (!m_drawCountsCulled)
+            return;
+        const VkBufferCopy region{0, 0, sizeof(m_drawCounts)};
+        vkCmdCopyBuffer(cmdBuf, m_drawCountBuffer.buffer, m_drawCountReadbacks[frameIndex].buffer, 1, &region);
+        VkMemoryBarrier barrier = nvvk::make<VkMemoryBarrier>();
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+        m_drawCountsCulled = false;
+    }
 
-            std::vector<VkImageMemoryBarrier> barriers{};
-            for (auto &texture : m_textures)
-                barriers.emplace_back(nvvk::makeImageMemoryBarrier(texture.gpuHandle.image, nvvk::accessFlagsForImageLayout(VK_IMAGE_LAYOUT_UNDEFINED), nvvk::accessFlagsForImageLayout(texture.gpuHandle.descriptor.imageLayout), VK_IMAGE_LAYOUT_UNDEFINED, texture.gpuHandle.descriptor.imageLayout));
-            vkCmdPipelineBarrier(scopedBuffer, nvvk::pipelineStageForLayout(VK_IMAGE_LAYOUT_UNDEFINED), nvvk::pipelineStageForLayout(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL), 0, 0, nullptr, 0, nullptr, barriers.size(), barriers.data());
+    // records the upload of the changed instance rows, before the passes read them
+    // the table is shared by all frames, the barrier orders the write after the reads of the frames still in flight;
+    // the rows are staged in a host visible buffer of the frame, which is reused once the frame comes round again
+    void cmdUpdateInstances(VkCommandBuffer cmdBuf, uint32_t frameIndex)
+    {
+        if ((!m_instanceTableDirty && m_dirtyInstances.empty()) || m_instanceRows.empty())
+            return;
+        // the whole table after a rebuild, the rows of the moved instances otherwise
+        std::vector<VkBufferCopy> regions{};
+        auto rowCount = 0ULL;
+        if (m_instanceTableDirty)
+        {
+            rowCount = m_instanceRows.size();
+            regions.push_back({0, 0, rowCount * sizeof(InstanceAttribute)});
         }
+        else
+            for (const auto instance : m_dirtyInstances)
+            {
+                const auto &placed = m_instances[instance];
+                regions.push_back({rowCount * sizeof(InstanceAttribute), static_cast<VkDeviceSize>(placed.firstRow) * sizeof(InstanceAttribute),
+                                   static_cast<VkDeviceSize>(placed.rowCount) * sizeof(InstanceAttribute)});
+                rowCount += placed.rowCount;
+            }
+        for (const auto instance : m_dirtyInstances)
+            m_instances[instance].rowsDirty = false;
+        m_dirtyInstances.clear();
 
-        std::vector<VkWriteDescriptorSet> writeDescs{};
-        VkDescriptorBufferInfo vertexInfo{m_vertexBuffer.buffer, 0, VK_WHOLE_SIZE};
-        writeDescs.emplace_back(m_geometryBinding.makeWrite(m_geometrySet, 0, &vertexInfo));
-        VkDescriptorBufferInfo triangleInfo{m_triangleBuffer.buffer, 0, VK_WHOLE_SIZE};
-        writeDescs.emplace_back(m_geometryBinding.makeWrite(m_geometrySet, 1, &triangleInfo));
-        VkDescriptorBufferInfo materialInfo{m_materialBuffer.buffer, 0, VK_WHOLE_SIZE};
-        writeDescs.emplace_back(m_geometryBinding.makeWrite(m_geometrySet, 2, &materialInfo));
-        VkDescriptorBufferInfo indexInfo{m_indexBuffer.buffer, 0, VK_WHOLE_SIZE};
-        writeDescs.emplace_back(m_geometryBinding.makeWrite(m_geometrySet, 3, &indexInfo));
-        for (auto i = 0; i < m_textures.size(); ++i)
-            writeDescs.emplace_back(m_textureBinding.makeWrite(m_textureSet, 0, &m_textures[i].gpuHandle.descriptor, i));
+        if (m_instanceStagings.size() <= frameIndex)
+            m_instanceStagings.resize(frameIndex + 1);
+        auto &staging = m_instanceStagings[frameIndex];
+        if (rowCount > staging.rowCapacity)
         {
-            nvvk::ScopeCommandBuffer scopedBuffer(m_deviceHandle, m_transferQueueFamilyIndex, m_transferQueue);
-            vkUpdateDescriptorSets(m_deviceHandle, writeDescs.size(), writeDescs.data(), 0, nullptr);
+            if (staging.buffer.buffer != VK_NULL_HANDLE)
+                m_allocatorHandle.destroy(staging.buffer);
+            staging.rowCapacity = grownCapacity(staging.rowCapacity, rowCount);
+            staging.buffer = m_allocatorHandle.createBuffer(static_cast<VkDeviceSize>(staging.rowCapacity) * sizeof(InstanceAttribute), VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                                            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
         }
+        auto *stagingData = static_cast<uint8_t *>(m_allocatorHandle.map(staging.buffer));
+        const auto *rowData = reinterpret_cast<const uint8_t *>(m_instanceRows.data());
+        for (const auto &region : regions)
+            memcpy(stagingData + region.srcOffset, rowData + region.dstOffset, region.size);
+        m_allocatorHandle.unmap(staging.buffer);
 
-        m_dirty = false;
+        constexpr auto shaderStages = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+        VkBufferMemoryBarrier barrier = nvvk::make<VkBufferMemoryBarrier>();
+        barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.srcQueueFamilyIndex = barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.buffer = m_instanceBuffer.buffer;
+        barrier.size = VK_WHOLE_SIZE;
+        vkCmdPipelineBarrier(cmdBuf, shaderStages, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+        vkCmdCopyBuffer(cmdBuf, staging.buffer.buffer, m_instanceBuffer.buffer, static_cast<uint32_t>(regions.size()), regions.data());
+        // new tables start with every row & meshlet hidden, the second culling phase draws the visible ones
+        if (m_instanceVisibilityNeedsClear)
+        {
+            vkCmdFillBuffer(cmdBuf, m_instanceVisibilityBuffer.buffer, 0, VK_WHOLE_SIZE, 0U);
+            m_instanceVisibilityNeedsClear = false;
+        }
+        if (m_meshletVisibilityNeedsClear)
+        {
+            vkCmdFillBuffer(cmdBuf, m_meshletVisibilityBuffer.buffer, 0, VK_WHOLE_SIZE, 0U);
+            m_meshletVisibilityNeedsClear = false;
+        }
+        VkMemoryBarrier writeBarrier = nvvk::make<VkMemoryBarrier>();
+        writeBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        writeBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT, shaderStages, 0, 1, &writeBarrier, 0, nullptr, 0, nullptr);
+        m_instanceTableDirty = false;
+    }
+
+    // records, after the shading pass, the copy of this frame's texture feedback for the CPU and clears it for the next frame
+    void cmdResolveFeedback(VkCommandBuffer cmdBuf, uint32_t frameIndex)
+    {
+        if (m_feedbackBuffer.buffer == VK_NULL_HANDLE || frameIndex >= m_feedbackReadbacks.size())
+            return;
+        const auto count = std::min(static_cast<uint32_t>(m_textures.size()), m_textureSetCapacity);
+        m_feedbackCounts[frameIndex] = count;
+        if (count == 0U)
+            return;
+
+        VkMemoryBarrier barrier = nvvk::make<VkMemoryBarrier>();
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+        const VkBufferCopy region{0, 0, count * sizeof(uint32_t)};
+        vkCmdCopyBuffer(cmdBuf, m_feedbackBuffer.buffer, m_feedbackReadbacks[frameIndex].buffer, 1, &region);
+        vkCmdFillBuffer(cmdBuf, m_feedbackBuffer.buffer, 0, count * sizeof(uint32_t), 0U);
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
     }
 
+    uint64_t residentTextureBytes() const { return m_textureStreamer.residentBytes(); }
+
     void deinit()
     {
+        for (auto &retired : m_retiredTextures)
+            m_allocatorHandle.destroy(retired.texture);
+        m_retiredTextures.clear();
+        if (m_feedbackBuffer.buffer)
+            m_allocatorHandle.destroy(m_feedbackBuffer);
+        for (auto &readback : m_feedbackReadbacks)
+            m_allocatorHandle.destroy(readback);
+        m_feedbackReadbacks.clear();
+        for (auto &readback : m_drawCountReadbacks)
+            m_allocatorHandle.destroy(readback);
+        m_drawCountReadbacks.clear();
         for (auto &texture : m_textures)
         {
             if (texture.gpuHandle.memHandle != nullptr)
                 m_allocatorHandle.destroy(texture.gpuHandle);
-            delete static_cast<unsigned char *>(texture.cpuHandle);
+            free(texture.cpuHandle);
         }
+        for (auto &pending : m_pendingTextures)
+            free(pending.texture.cpuHandle);
+        m_pendingTextures.clear();
+        if (m_defaultTexture.memHandle != nullptr)
+            m_allocatorHandle.destroy(m_defaultTexture);
 
-        if (m_vertexBuffer.buffer)
-            m_allocatorHandle.destroy(m_vertexBuffer);
-        if (m_triangleBuffer.buffer)
-            m_allocatorHandle.destroy(m_triangleBuffer);
-        if (m_materialBuffer.buffer)
-            m_allocatorHandle.destroy(m_materialBuffer);
-        if (m_indexBuffer.buffer)
-            m_allocatorHandle.destroy(m_indexBuffer);
+        m_vertexHeap.deinit();
+        m_triangleHeap.deinit();
+        m_boundsHeap.deinit();
+        m_meshHeap.deinit();
+        m_meshletHeap.deinit();
+        m_materialHeap.deinit();
+        if (m_instanceBuffer.buffer)
+            m_allocatorHandle.destroy(m_instanceBuffer);
+        for (auto &staging : m_instanceStagings)
+            if (staging.buffer.buffer)
+                m_allocatorHandle.destroy(staging.buffer);
+        m_instanceStagings.clear();
+        if (m_drawBuffer.buffer)
+            m_allocatorHandle.destroy(m_drawBuffer);
+        if (m_drawCountBuffer.buffer)
+            m_allocatorHandle.destroy(m_drawCountBuffer);
+        for (auto *buffer : {&m_instanceVisibilityBuffer, &m_clusterJobBuffer, &m_meshletVisibilityBuffer})
+            if (buffer->buffer)
+                m_allocatorHandle.destroy(*buffer);
+        m_uploader.deinit();
 
+        for (const auto &retired : m_retiredTexturePools)
+            vkDestroyDescriptorPool(m_deviceHandle, retired.pool, VK_NULL_HANDLE);
+        m_retiredTexturePools.clear();
+        if (m_texturePool)
+            vkDestroyDescriptorPool(m_deviceHandle, m_texturePool, VK_NULL_HANDLE);
         if (m_geometrySetLayout)
             vkDestroyDescriptorSetLayout(m_deviceHandle, m_geometrySetLayout, VK_NULL_HANDLE);
         if (m_textureSetLayout)
@@ -207,24 +482,734 @@ protected:
     Scene() {}
     ~Scene() {}
 
+    // texture sets start with this many slots and double when the scene outgrows them
+    static constexpr uint32_t initialTextureSetCapacity = 256U;
+    // keeps pools reasonable on drivers reporting (almost) unlimited descriptors
+    static constexpr uint32_t textureSetHardLimit = 1U << 20;
+    // samplers of the other sets sharing the shading stage's limits
+    static constexpr uint32_t reservedSamplerCount = 16U;
+
+    struct sPendingMaterials
+    {
+        uint32_t groupIndex{};
+        std::vector<Material> materials{};
+        size_t textureCount{};
+    };
+    struct sPendingMesh
+    {
+        uint32_t groupIndex{};
+        Mesh mesh{};
+    };
+    struct sPendingTexture
+    {
+        uint32_t groupIndex{};
+        uint32_t textureIndex{};
+        Texture texture{};
+    };
+    // where a streamed model's materials & textures start in the scene containers
+    struct sStreamingBase
+    {
+        uint32_t material{};
+        uint32_t texture{};
+    };
+    // a replaced texture pool, destroyed once no frame in flight can still use its sets
+    struct sRetiredTexturePool
+    {
+        VkDescriptorPool pool{};
+        uint32_t pendingFrames{}; // bit per swapchain image
+    };
+    struct sMeshRef
+    {
+        uint32_t groupIndex{};
+        uint32_t meshIndex{};
+    };
+    // same for a texture image replaced by the streaming
+    struct sRetiredTexture
+    {
+        nvvk::Texture texture{};
+        uint32_t pendingFrames{};
+    };
+    // where a mesh lives in the heaps, the index ranges of its levels are in its MeshAttribute
+    struct sMeshDraw
+    {
+        uint32_t groupIndex{};
+        uint32_t vertexOffset{};
+        uint32_t boundsSlot{};
+        uint32_t meshSlot{};
+        uint32_t triangleOffset{};
+        uint32_t triangleCount{};
+        uint32_t meshletOffset{};
+        uint32_t meshletCount{0U};
+    };
+    // a placement of an object group, its rows are m_instanceRows[firstRow, firstRow + rowCount)
+    struct sInstance
+    {
+        uint32_t groupIndex{};
+        nvmath::mat4f transform{nvmath::mat4f_id};
+        uint32_t firstRow{0U};
+        uint32_t rowCount{0U};
+        // listed in m_dirtyInstances
+        bool rowsDirty{false};
+    };
+    // host visible copy of the rows a frame uploads
+    struct sInstanceStaging
+    {
+        nvvk::Buffer buffer{};
+        uint32_t rowCapacity{0U};
+    };
+
+    void applyPendingUpdates()
+    {
+        std::vector<sPendingMaterials> pendingMaterials{};
+        std::vector<sPendingMesh> pendingMeshes{};
+        std::vector<sPendingTexture> pendingTextures{};
+        {
+            std::lock_guard<std::mutex> lock(m_pendingMutex);
+            pendingMaterials.swap(m_pendingMaterials);
+            pendingMeshes.swap(m_pendingMeshes);
+            pendingTextures.swap(m_pendingTextures);
+        }
+
+        // texture slots are reserved up front and stay non-resident until their pixels arrive
+        for (auto &pending : pendingMaterials)
+        {
+            const sStreamingBase base{static_cast<uint32_t>(m_materials.size()), static_cast<uint32_t>(m_textures.size())};
+            m_streamingBases[pending.groupIndex] = base;
+            for (auto &material : pending.materials)
+            {
+                material.offsetTextureIndices(base.texture);
+                m_materials.emplace_back(std::move(material));
+            }
+            m_textures.resize(m_textures.size() + pending.textureCount);
+            m_dirty = true;
+            m_texturesDirty = true;
+        }
+        for (auto &pending : pendingMeshes)
+        {
+            pending.mesh.offsetMaterialIndices(m_streamingBases[pending.groupIndex].material);
+            m_unuploadedMeshes.push_back({pending.groupIndex, static_cast<uint32_t>(m_objects[pending.groupIndex].size())});
+            m_objects[pending.groupIndex].emplace_back(std::move(pending.mesh));
+            m_dirty = true;
+        }
+        for (auto &pending : pendingTextures)
+        {
+            auto &texture = m_textures[m_streamingBases[pending.groupIndex].texture + pending.textureIndex];
+            free(texture.cpuHandle);
+            texture = pending.texture;
+            m_texturesDirty = true;
+        }
+    }
+
+    // uploads textures whose pixels are on the CPU only, non-resident slots sample the default texture
+    // changed slots are queued for every frame's set, see updateTextureSet
+    void updateTextures()
+    {
+        if (m_defaultTexture.image == VK_NULL_HANDLE)
+        {
+            uint32_t white = 0xFFFFFFFFU;
+            Texture texture{};
+            texture.width = texture.height = 1;
+            texture.format = VK_FORMAT_R8G8B8A8_UNORM;
+            texture.cpuHandle = &white;
+            m_defaultTexture = uploadTexture(m_uploader.getCommandBuffer(), texture);
+        }
+
+        // new textures start with their tail levels, the feedback requests the finer ones
+        for (auto i = 0U; i < m_textures.size(); ++i)
+            if (m_textures[i].cpuHandle != nullptr && m_textures[i].gpuHandle.memHandle == nullptr)
+            {
+                std::vector<size_t> levelSizes(m_textures[i].mipLevels);
+                for (auto level = 0U; level < m_textures[i].mipLevels; ++level)
+                    levelSizes[level] = m_textures[i].levelSize(level);
+                const auto baseLevel = m_textureStreamer.addTexture(i, m_textures[i].width, m_textures[i].height, levelSizes);
+                m_textures[i].gpuHandle = uploadTexture(m_uploader.getCommandBuffer(), m_textures[i], baseLevel);
+                markTextureSlot(i);
+            }
+        // newly reserved slots start with the default texture
+        for (auto i = m_reservedTextureCount; i < m_textures.size(); ++i)
+            markTextureSlot(i);
+        m_reservedTextureCount = static_cast<uint32_t>(m_textures.size());
+
+        if (m_textures.size() > m_textureSetLimit)
+            printf("WARNING: scene has %zu textures, only the first %u are bound.\n", m_textures.size(), m_textureSetLimit);
+        m_texturesDirty = false;
+    }
+
+    void markTextureSlot(uint32_t slot)
+    {
+        for (auto &slots : m_textureSetDirtySlots)
+            slots.push_back(slot);
+    }
+
+    // uploads the meshes & materials added since the last frame into their own ranges of the heaps
+    void updateGeometry(uint32_t frameIndex)
+    {
+        for (auto *heap : {&m_vertexHeap, &m_triangleHeap, &m_boundsHeap, &m_meshHeap, &m_meshletHeap, &m_materialHeap})
+            heap->releaseFrame(frameIndex);
+        // faces can't refer to anything before materials arrive
+        if (!m_dirty || m_materials.empty())
+            return;
+        m_dirty = false;
+
+        // the vertex layout is scene wide, only meshes it can't hold re-upload everything
+        auto rebuild = m_materialHeap.capacity() == 0U;
+        if (m_quantizedVertices)
+        {
+            rebuild |= m_boundsHeap.used() + m_unuploadedMeshes.size() > 0x10000ULL;
+            for (const auto &mesh : m_unuploadedMeshes)
+                rebuild |= !m_objects[mesh.groupIndex][mesh.meshIndex].quantized();
+        }
+        if (rebuild)
+            resetGeometry();
+
+        // every range is allocated before the batch writes into any of them, as growing copies the heaps on the graphics queue
+        std::vector<nvvk::Buffer> replaced{};
+        auto relocated = false;
+        const auto materialCount = m_materials.size() - m_uploadedMaterialCount;
+        uint32_t materialOffset{};
+        if (materialCount > 0U)
+            materialOffset = allocateGeometry(m_materialHeap, materialCount, replaced, relocated);
+        std::vector<sMeshDraw> draws(m_unuploadedMeshes.size());
+        std::vector<bool> drawable(m_unuploadedMeshes.size());
+        for (auto i = 0ULL; i < m_unuploadedMeshes.size(); ++i)
+        {
+            const auto &mesh = m_unuploadedMeshes[i];
+            drawable[i] = allocateMesh(mesh.groupIndex, m_objects[mesh.groupIndex][mesh.meshIndex], draws[i], replaced, relocated);
+        }
+        // growing has idled the device, nothing in flight uses the old buffers
+        for (auto &buffer : replaced)
+            m_allocatorHandle.destroy(buffer);
+        if (relocated)
+            writeGeometrySet();
+
+        if (materialCount > 0U)
+        {
+            std::vector<MaterialAttribute> materialData{};
+            materialData.reserve(materialCount);
+            for (auto i = m_uploadedMaterialCount; i < m_materials.size(); ++i)
+                materialData.emplace_back(m_materials[i].properties);
+            // nothing is ever freed, so the range directly follows the uploaded ones
+            uploadGeometry(m_materialHeap, 0, materialOffset, materialData.size(), materialData.data());
+            m_uploadedMaterialCount = static_cast<uint32_t>(m_materials.size());
+        }
+        for (auto i = 0ULL; i < m_unuploadedMeshes.size(); ++i)
+            if (drawable[i])
+                uploadMesh(m_objects[m_unuploadedMeshes[i].groupIndex][m_unuploadedMeshes[i].meshIndex], draws[i]);
+        m_unuploadedMeshes.clear();
+    }
+
+    // drops all geometry and queues every mesh again, choosing the vertex layout anew
+    void resetGeometry()
+    {
+        if (m_materialHeap.capacity() > 0U)
+            waitForUploads();
+        auto meshCount = 0ULL;
+        m_quantizedVertices = true;
+        m_unuploadedMeshes.clear();
+        for (auto groupIndex = 0U; groupIndex < m_objects.size(); ++groupIndex)
+            for (auto meshIndex = 0U; meshIndex < m_objects[groupIndex].size(); ++meshIndex)
+            {
+                m_quantizedVertices &= m_objects[groupIndex][meshIndex].quantized();
+                m_unuploadedMeshes.push_back({groupIndex, meshIndex});
+                ++meshCount;
+            }
+        m_quantizedVertices &= meshCount <= 0x10000ULL;
+
+        for (auto *heap : {&m_vertexHeap, &m_triangleHeap, &m_boundsHeap, &m_meshHeap, &m_meshletHeap, &m_materialHeap})
+            heap->deinit();
+        constexpr auto usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+        m_vertexHeap.init(&m_allocatorHandle, {static_cast<uint32_t>(m_quantizedVertices ? sizeof(QuantizedVertex) : sizeof(VertexAttribute))}, usage);
+        m_triangleHeap.init(&m_allocatorHandle, {sizeof(FaceAttribute), 3 * sizeof(uint32_t)}, usage | VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+        m_boundsHeap.init(&m_allocatorHandle, {sizeof(VertexBounds)}, usage);
+        m_meshHeap.init(&m_allocatorHandle, {sizeof(MeshAttribute)}, usage);
+        // meshes without meshlets allocate nothing, the heap is never left without a buffer to bind
+        m_meshletHeap.init(&m_allocatorHandle, {sizeof(Meshlet)}, usage);
+        m_meshletHeap.grow(VK_NULL_HANDLE, 1U);
+        m_materialHeap.init(&m_allocatorHandle, {sizeof(MaterialAttribute)}, usage);
+        m_uploadedMaterialCount = 0U;
+        m_meshDraws.clear();
+        m_instancesDirty = true;
+        m_geometryBound = false;
+    }
+
+    // the blocking path of the rare reallocations: once the device is idle, the graphics queue takes over every submitted upload
+    void waitForUploads()
+    {
+        vkDeviceWaitIdle(m_deviceHandle);
+        nvvk::ScopeCommandBuffer scopedBuffer(m_deviceHandle, m_graphicsQueueFamilyIndex, m_graphicsQueue);
+        m_uploader.cmdAcquire(scopedBuffer);
+    }
+
+    // a full heap doubles, relocated tells the geometry set has to be rewritten
+    uint32_t allocateGeometry(GeometryHeap &heap, size_t count, std::vector<nvvk::Buffer> &replaced, bool &relocated)
+    {
+        uint32_t offset{};
+        while (!heap.allocate(static_cast<uint32_t>(count), offset))
+        {
+            const auto minCapacity = std::max(heap.capacity() + 1, heap.used() + static_cast<uint32_t>(count));
+            if (heap.capacity() == 0U)
+                heap.grow(VK_NULL_HANDLE, minCapacity);
+            else
+            {
+                // the copy reads ranges released to the graphics queue, so it runs there
+                waitForUploads();
+                nvvk::ScopeCommandBuffer scopedBuffer(m_deviceHandle, m_graphicsQueueFamilyIndex, m_graphicsQueue);
+                auto old = heap.grow(scopedBuffer, minCapacity);
+                replaced.insert(replaced.end(), old.begin(), old.end());
+            }
+            relocated = true;
+        }
+        return offset;
+    }
+
+    // the range is handed over to the graphics queue at the end of the batch
+    void uploadGeometry(GeometryHeap &heap, uint32_t stream, uint32_t offset, size_t count, const void *data)
+    {
+        heap.upload(m_uploader.getCommandBuffer(), stream, offset, static_cast<uint32_t>(count), data);
+        m_uploader.releaseBuffer(heap.buffer(stream).buffer, static_cast<VkDeviceSize>(offset) * heap.elementSize(stream),
+                                 static_cast<VkDeviceSize>(count) * heap.elementSize(stream));
+    }
+
+    static size_t triangleCount(const Mesh &object)
+    {
+        auto count = object.indices.size() / 3;
+        for (const auto &lod : object.lods)
+            count += lod.indices.size() / 3;
+        return count;
+    }
+
+    // reserves the mesh's ranges in the heaps, false for meshes without anything to draw
+    bool allocateMesh(uint32_t groupIndex, const Mesh &object, sMeshDraw &draw, std::vector<nvvk::Buffer> &replaced, bool &relocated)
+    {
+        if (object.vertices.empty() || triangleCount(object) == 0)
+            return false;
+        draw.groupIndex = groupIndex;
+        draw.vertexOffset = allocateGeometry(m_vertexHeap, object.vertices.size(), replaced, relocated);
+        draw.boundsSlot = allocateGeometry(m_boundsHeap, 1, replaced, relocated);
+        draw.meshSlot = allocateGeometry(m_meshHeap, 1, replaced, relocated);
+        draw.triangleOffset = allocateGeometry(m_triangleHeap, triangleCount(object), replaced, relocated);
+        draw.meshletCount = static_cast<uint32_t>(object.meshlets.size());
+        if (draw.meshletCount > 0U)
+            draw.meshletOffset = allocateGeometry(m_meshletHeap, draw.meshletCount, replaced, relocated);
+        return true;
+    }
+
+    // every level gets its own triangles, they all index the mesh's vertices
+    void uploadMesh(const Mesh &object, sMeshDraw &draw)
+    {
+        const auto triangles = triangleCount(object);
+        draw.triangleCount = static_cast<uint32_t>(triangles);
+        MeshAttribute mesh{};
+        mesh.boundingMin = nvmath::vec4f(object.bounding.minPoint, 1.f);
+        mesh.boundingMax = nvmath::vec4f(object.bounding.maxPoint, 1.f);
+
+        if (m_quantizedVertices)
+        {
+            auto quantizedData = object.quantizedVertices;
+            for (auto &vertex : quantizedData)
+                vertex.boundsIndex = static_cast<uint16_t>(draw.boundsSlot);
+            uploadGeometry(m_vertexHeap, 0, draw.vertexOffset, quantizedData.size(), quantizedData.data());
+        }
+        else
+            uploadGeometry(m_vertexHeap, 0, draw.vertexOffset, object.vertices.size(), object.vertices.data());
+        const auto bounds = object.getVertexBounds();
+        uploadGeometry(m_boundsHeap, 0, draw.boundsSlot, 1, &bounds);
+
+        std::vector<FaceAttribute> faceData{};
+        std::vector<uint32_t> indexData{};
+        faceData.reserve(triangles);
+        indexData.reserve(triangles * 3);
+        auto appendLevel = [&](const std::vector<uint32_t> &indices, const std::vector<FaceAttribute> &faces, float error)
+        {
+            mesh.firstIndex[mesh.levelCount] = 3 * draw.triangleOffset + static_cast<uint32_t>(indexData.size());
+            mesh.indexCount[mesh.levelCount] = static_cast<uint32_t>(indices.size());
+            mesh.error[mesh.levelCount++] = error;
+            faceData.insert(faceData.end(), faces.begin(), faces.end());
+            for (const auto index : indices)
+                indexData.push_back(index + draw.vertexOffset);
+        };
+        appendLevel(object.indices, object.faces, 0.f);
+        for (const auto &lod : object.lods)
+            appendLevel(lod.indices, lod.faces, lod.error);
+        uploadGeometry(m_triangleHeap, 0, draw.triangleOffset, triangles, faceData.data());
+        uploadGeometry(m_triangleHeap, 1, draw.triangleOffset, triangles, indexData.data());
+        // meshlets index level 0, which comes first in the mesh's triangles
+        mesh.firstMeshlet = draw.meshletOffset;
+        mesh.meshletCount = draw.meshletCount;
+        if (draw.meshletCount > 0U)
+            uploadGeometry(m_meshletHeap, 0, draw.meshletOffset, draw.meshletCount, object.meshlets.data());
+        uploadGeometry(m_meshHeap, 0, draw.meshSlot, 1, &mesh);
+        m_meshDraws.emplace_back(draw);
+        m_instancesDirty = true;
+    }
+
+    static uint32_t grownCapacity(uint32_t capacity, size_t count)
+    {
+        capacity = std::max(capacity, initialInstanceCapacity);
+        while (capacity < count)
+            capacity *= 2;
+        return capacity;
+    }
+
+    // one row per mesh of every instance, rows of the same mesh share its geometry
+    // an instance's rows are contiguous, so moving it only patches its own range, see setInstanceTransform
+    void updateInstances()
+    {
+        std::vector<std::vector<uint32_t>> groupDraws(m_objects.size());
+        for (auto i = 0U; i < m_meshDraws.size(); ++i)
+            groupDraws[m_meshDraws[i].groupIndex].push_back(i);
+
+        m_instanceRows.clear();
+        auto meshletFlagCount = 0U;
+        for (auto &instance : m_instances)
+        {
+            InstanceAttribute row{};
+            row.transform = instance.transform;
+            row.normalTransform = nvmath::transpose(nvmath::invert(instance.transform));
+            instance.firstRow = static_cast<uint32_t>(m_instanceRows.size());
+            instance.rowCount = static_cast<uint32_t>(groupDraws[instance.groupIndex].size());
+            instance.rowsDirty = false;
+            for (const auto i : groupDraws[instance.groupIndex])
+            {
+                row.firstTriangle = m_meshDraws[i].triangleOffset;
+                row.triangleCount = m_meshDraws[i].triangleCount;
+                row.meshIndex = m_meshDraws[i].meshSlot;
+                row.firstMeshletVisibility = meshletFlagCount;
+                meshletFlagCount += m_meshDraws[i].meshletCount;
+                m_instanceRows.push_back(row);
+            }
+        }
+        // the whole table is uploaded
+        m_dirtyInstances.clear();
+
+        // the counts of the culling passes, see m_drawCounts
+        if (m_drawCountBuffer.buffer == VK_NULL_HANDLE)
+        {
+            m_drawCountBuffer = m_allocatorHandle.createBuffer(sizeof(m_drawCounts), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                                                                                         VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+            VkDescriptorBufferInfo countInfo{m_drawCountBuffer.buffer, 0, VK_WHOLE_SIZE};
+            const auto writeDesc = m_geometryBinding.makeWrite(m_geometrySet, 8, &countInfo);
+            vkUpdateDescriptorSets(m_deviceHandle, 1, &writeDesc, 0, nullptr);
+            while (m_drawCountReadbacks.size() < m_textureSetFrameCount)
+                m_drawCountReadbacks.emplace_back(m_allocatorHandle.createBuffer(sizeof(m_drawCounts), VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                                                                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT));
+            m_drawCountsResolved.assign(m_drawCountReadbacks.size(), false);
+        }
+        // the table & what the culling passes write from it are shared by all frames, so growing waits for them like the heaps do
+        std::vector<VkWriteDescriptorSet> writeDescs{};
+        std::vector<VkDescriptorBufferInfo> bufferInfos{};
+        bufferInfos.reserve(5);
+        auto idle = false;
+        auto replaceBuffer = [&](nvvk::Buffer &buffer, VkDeviceSize size, VkBufferUsageFlags usage, uint32_t binding)
+        {
+            if (buffer.buffer != VK_NULL_HANDLE)
+            {
+                if (!idle)
+                    vkDeviceWaitIdle(m_deviceHandle);
+                idle = true;
+                m_allocatorHandle.destroy(buffer);
+            }
+            buffer = m_allocatorHandle.createBuffer(size, usage);
+            bufferInfos.push_back({buffer.buffer, 0, VK_WHOLE_SIZE});
+            writeDescs.emplace_back(m_geometryBinding.makeWrite(m_geometrySet, binding, &bufferInfos.back()));
+        };
+        if (m_instanceRows.size() > m_instanceCapacity)
+        {
+            m_instanceCapacity = grownCapacity(m_instanceCapacity, m_instanceRows.size());
+            replaceBuffer(m_instanceBuffer, static_cast<VkDeviceSize>(m_instanceCapacity) * sizeof(InstanceAttribute), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, 5);
+            replaceBuffer(m_instanceVisibilityBuffer, static_cast<VkDeviceSize>(m_instanceCapacity) * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, 9);
+            replaceBuffer(m_clusterJobBuffer, static_cast<VkDeviceSize>(m_instanceCapacity) * 2 * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, 11);
+            m_instanceVisibilityNeedsClear = true;
+        }
+        // at most one draw per row, or one per meshlet of its level 0
+        m_maxDrawCount = static_cast<uint32_t>(m_instanceRows.size()) + meshletFlagCount;
+        if (m_maxDrawCount > m_drawCapacity)
+        {
+            m_drawCapacity = grownCapacity(m_drawCapacity, m_maxDrawCount);
+            replaceBuffer(m_drawBuffer, static_cast<VkDeviceSize>(m_drawCapacity) * sizeof(DrawCommand), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, 7);
+        }
+        if (meshletFlagCount > m_meshletVisibilityCapacity || (m_meshletVisibilityBuffer.buffer == VK_NULL_HANDLE && !m_instanceRows.empty()))
+        {
+            m_meshletVisibilityCapacity = grownCapacity(m_meshletVisibilityCapacity, meshletFlagCount);
+            replaceBuffer(m_meshletVisibilityBuffer, static_cast<VkDeviceSize>(m_meshletVisibilityCapacity) * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, 12);
+            m_meshletVisibilityNeedsClear = true;
+        }
+        if (!writeDescs.empty())
+            vkUpdateDescriptorSets(m_deviceHandle, writeDescs.size(), writeDescs.data(), 0, nullptr);
+        m_instancesDirty = false;
+        m_instanceTableDirty = true;
+    }
+
+    void writeGeometrySet()
+    {
+        std::vector<VkWriteDescriptorSet> writeDescs{};
+        VkDescriptorBufferInfo vertexInfo{m_vertexHeap.buffer(0).buffer, 0, VK_WHOLE_SIZE};
+        writeDescs.emplace_back(m_geometryBinding.makeWrite(m_geometrySet, 0, &vertexInfo));
+        VkDescriptorBufferInfo triangleInfo{m_triangleHeap.buffer(0).buffer, 0, VK_WHOLE_SIZE};
+        writeDescs.emplace_back(m_geometryBinding.makeWrite(m_geometrySet, 1, &triangleInfo));
+        VkDescriptorBufferInfo materialInfo{m_materialHeap.buffer(0).buffer, 0, VK_WHOLE_SIZE};
+        writeDescs.emplace_back(m_geometryBinding.makeWrite(m_geometrySet, 2, &materialInfo));
+        VkDescriptorBufferInfo indexInfo{m_triangleHeap.buffer(1).buffer, 0, VK_WHOLE_SIZE};
+        writeDescs.emplace_back(m_geometryBinding.makeWrite(m_geometrySet, 3, &indexInfo));
+        VkDescriptorBufferInfo boundsInfo{m_boundsHeap.buffer(0).buffer, 0, VK_WHOLE_SIZE};
+        writeDescs.emplace_back(m_geometryBinding.makeWrite(m_geometrySet, 4, &boundsInfo));
+        VkDescriptorBufferInfo meshInfo{m_meshHeap.buffer(0).buffer, 0, VK_WHOLE_SIZE};
+        writeDescs.emplace_back(m_geometryBinding.makeWrite(m_geometrySet, 6, &meshInfo));
+        VkDescriptorBufferInfo meshletInfo{m_meshletHeap.buffer(0).buffer, 0, VK_WHOLE_SIZE};
+        writeDescs.emplace_back(m_geometryBinding.makeWrite(m_geometrySet, 10, &meshletInfo));
+        vkUpdateDescriptorSets(m_deviceHandle, writeDescs.size(), writeDescs.data(), 0, nullptr);
+        m_geometryBound = true;
+    }
+
+    // the counts of this frame's last culling pass, if it ran
+    void readDrawCounts(uint32_t frameIndex)
+    {
+        if (frameIndex >= m_drawCountReadbacks.size() || !m_drawCountsResolved[frameIndex])
+            return;
+        const auto *counts = static_cast<const uint32_t *>(m_allocatorHandle.map(m_drawCountReadbacks[frameIndex]));
+        std::copy(counts, counts + 12, m_drawCounts);
+        m_allocatorHandle.unmap(m_drawCountReadbacks[frameIndex]);
+        m_drawCountsResolved[frameIndex] = false;
+    }
+
+    // reads back the feedback of this frame's last run and re-uploads the textures whose resident levels change,
+    // replaced images are kept alive until the other frames in flight are done with them
+    void streamTextures(uint32_t frameIndex)
+    {
+        const auto inFlightFrames = ((1U << m_textureSets.size()) - 1U) & ~(1U << frameIndex);
+        for (auto &retired : m_retiredTextures)
+        {
+            retired.pendingFrames &= ~(1U << frameIndex);
+            if (retired.pendingFrames == 0U)
+                m_allocatorHandle.destroy(retired.texture);
+        }
+        std::erase_if(m_retiredTextures, [](const sRetiredTexture &retired)
+                      { return retired.pendingFrames == 0U; });
+
+        if (frameIndex < m_feedbackReadbacks.size() && m_feedbackCounts[frameIndex] > 0U)
+        {
+            const auto *feedback = static_cast<const uint32_t *>(m_allocatorHandle.map(m_feedbackReadbacks[frameIndex]));
+            m_textureStreamer.readFeedback(feedback, m_feedbackCounts[frameIndex]);
+            m_allocatorHandle.unmap(m_feedbackReadbacks[frameIndex]);
+        }
+        else
+            m_textureStreamer.readFeedback(nullptr, 0ULL);
+
+        std::vector<TextureStreamer::sChange> changes{};
+        m_textureStreamer.update(m_textureBudget, streamingUploadLimit, changes);
+        for (const auto &change : changes)
+        {
+            auto &texture = m_textures[change.slot];
+            if (inFlightFrames == 0U)
+                m_allocatorHandle.destroy(texture.gpuHandle);
+            else
+                m_retiredTextures.push_back({texture.gpuHandle, inFlightFrames});
+            texture.gpuHandle = uploadTexture(m_uploader.getCommandBuffer(), texture, change.baseLevel);
+            markTextureSlot(change.slot);
+        }
+    }
+
+    // every swapchain image has its own texture set, so slots are rewritten without waiting for the other frames:
+    // a set only receives the writes gathered since its frame last ran, once that frame's fence has been waited on
+    void updateTextureSet(uint32_t frameIndex)
+    {
+        for (auto &retired : m_retiredTexturePools)
+        {
+            retired.pendingFrames &= ~(1U << frameIndex);
+            if (retired.pendingFrames == 0U)
+                vkDestroyDescriptorPool(m_deviceHandle, retired.pool, VK_NULL_HANDLE);
+        }
+        std::erase_if(m_retiredTexturePools, [](const sRetiredTexturePool &retired)
+                      { return retired.pendingFrames == 0U; });
+
+        const auto requiredCount = std::min(static_cast<uint32_t>(m_textures.size()), m_textureSetLimit);
+        const auto frameCount = std::max({m_textureSetFrameCount, frameIndex + 1, static_cast<uint32_t>(m_textureSets.size())});
+        if (requiredCount > m_textureSetCapacity || frameCount > m_textureSets.size())
+            growTextureSets(requiredCount, frameCount, frameIndex);
+
+        std::vector<VkWriteDescriptorSet> writeDescs{};
+        auto &slots = m_textureSetDirtySlots[frameIndex];
+        std::sort(slots.begin(), slots.end());
+        slots.erase(std::unique(slots.begin(), slots.end()), slots.end());
+        writeDescs.reserve(slots.size());
+        for (const auto slot : slots)
+        {
+            if (slot >= m_textureSetCapacity)
+                break;
+            const auto &gpuHandle = m_textures[slot].gpuHandle.memHandle != nullptr ? m_textures[slot].gpuHandle : m_defaultTexture;
+            writeDescs.emplace_back(m_textureBinding.makeWrite(m_textureSets[frameIndex], 1, &gpuHandle.descriptor, slot));
+        }
+        if (!writeDescs.empty())
+            vkUpdateDescriptorSets(m_deviceHandle, writeDescs.size(), writeDescs.data(), 0, nullptr);
+        slots.clear();
+        m_textureSet = m_textureSets[frameIndex];
+    }
+
+    // sets are reallocated from a new pool and rewritten entirely, the old pool is kept until its sets are no longer in flight
+    void growTextureSets(uint32_t requiredCount, uint32_t frameCount, uint32_t frameIndex)
+    {
+        auto capacity = std::max(m_textureSetCapacity, initialTextureSetCapacity);
+        while (capacity < requiredCount)
+            capacity *= 2;
+        capacity = std::min(capacity, m_textureSetLimit);
+
+        if (m_texturePool)
+        {
+            // the current frame's set is already free
+            const auto pendingFrames = ((1U << m_textureSets.size()) - 1U) & ~(1U << frameIndex);
+            if (pendingFrames == 0U)
+                vkDestroyDescriptorPool(m_deviceHandle, m_texturePool, VK_NULL_HANDLE);
+            else
+                m_retiredTexturePools.push_back({m_texturePool, pendingFrames});
+        }
+
+        std::array<VkDescriptorPoolSize, 2> poolSizes{};
+        poolSizes[0] = {VkDescriptorType::VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frameCount};
+        poolSizes[1] = {VkDescriptorType::VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, capacity * frameCount};
+        VkDescriptorPoolCreateInfo createInfo = nvvk::make<VkDescriptorPoolCreateInfo>();
+        createInfo.flags = VkDescriptorPoolCreateFlagBits::VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+        createInfo.maxSets = frameCount;
+        createInfo.poolSizeCount = poolSizes.size();
+        createInfo.pPoolSizes = poolSizes.data();
+        NVVK_CHECK(vkCreateDescriptorPool(m_deviceHandle, &createInfo, VK_NULL_HANDLE, &m_texturePool));
+
+        std::vector<VkDescriptorSetLayout> layouts(frameCount, m_textureSetLayout);
+        std::vector<uint32_t> counts(frameCount, capacity);
+        VkDescriptorSetAllocateInfo allocInfo = nvvk::make<VkDescriptorSetAllocateInfo>();
+        allocInfo.descriptorPool = m_texturePool;
+        allocInfo.descriptorSetCount = frameCount;
+        allocInfo.pSetLayouts = layouts.data();
+        VkDescriptorSetVariableDescriptorCountAllocateInfo variableInfo = nvvk::make<VkDescriptorSetVariableDescriptorCountAllocateInfo>();
+        variableInfo.descriptorSetCount = frameCount;
+        variableInfo.pDescriptorCounts = counts.data();
+        allocInfo.pNext = &variableInfo;
+        m_textureSets.resize(frameCount);
+        NVVK_CHECK(vkAllocateDescriptorSets(m_deviceHandle, &allocInfo, m_textureSets.data()));
+        m_textureSetCapacity = capacity;
+
+        // one feedback slot per bindable texture, the readbacks are per frame as the CPU reads them frames later
+        if (m_feedbackBuffer.buffer == VK_NULL_HANDLE)
+        {
+            const VkDeviceSize feedbackSize = static_cast<VkDeviceSize>(m_textureSetLimit) * sizeof(uint32_t);
+            m_feedbackBuffer = m_allocatorHandle.createBuffer(feedbackSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+            // only the graphics queue touches it, cleared by cmdAcquireUploads
+            m_feedbackNeedsClear = true;
+        }
+        while (m_feedbackReadbacks.size() < frameCount)
+            m_feedbackReadbacks.emplace_back(m_allocatorHandle.createBuffer(static_cast<VkDeviceSize>(m_textureSetLimit) * sizeof(uint32_t), VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                                                            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT));
+        m_feedbackCounts.resize(frameCount, 0U);
+        std::vector<VkWriteDescriptorSet> writeDescs{};
+        VkDescriptorBufferInfo feedbackInfo{m_feedbackBuffer.buffer, 0, VK_WHOLE_SIZE};
+        for (const auto set : m_textureSets)
+            writeDescs.emplace_back(m_textureBinding.makeWrite(set, 0, &feedbackInfo));
+        vkUpdateDescriptorSets(m_deviceHandle, writeDescs.size(), writeDescs.data(), 0, nullptr);
+
+        m_textureSetDirtySlots.assign(frameCount, {});
+        for (auto &slots : m_textureSetDirtySlots)
+            for (auto i = 0U; i < std::min(m_reservedTextureCount, capacity); ++i)
+                slots.push_back(i);
+    }
+
+    // the image holds the levels [baseLevel, mipLevels) of the chain in texture.cpuHandle,
+    // createImage only copies its first level, the others follow it in memory
+    // cmdBuf belongs to m_uploader's batch, the image is sampled once the graphics queue has acquired it
+    nvvk::Texture uploadTexture(VkCommandBuffer cmdBuf, const Texture &texture, uint32_t baseLevel = 0U)
+    {
+        const auto *pixels = static_cast<const uint8_t *>(texture.cpuHandle);
+        for (auto level = 0U; level < baseLevel; ++level)
+            pixels += texture.levelSize(level);
+        const VkExtent2D extent{std::max(static_cast<uint32_t>(texture.width) >> baseLevel, 1U), std::max(static_cast<uint32_t>(texture.height) >> baseLevel, 1U)};
+        const auto levelCount = texture.mipLevels - baseLevel;
+        auto imageInfo = nvvk::makeImage2DCreateInfo(extent, texture.format);
+        imageInfo.mipLevels = levelCount;
+        const auto image = m_allocatorHandle.createImage(cmdBuf, texture.levelSize(baseLevel), pixels, imageInfo, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+        for (auto level = 1U; level < levelCount; ++level)
+        {
+            pixels += texture.levelSize(baseLevel + level - 1);
+            const VkExtent3D levelExtent{std::max(extent.width >> level, 1U), std::max(extent.height >> level, 1U), 1U};
+            VkImageSubresourceLayers subresource{VK_IMAGE_ASPECT_COLOR_BIT, level, 0U, 1U};
+            m_allocatorHandle.getStaging()->cmdToImage(cmdBuf, image.image, {}, levelExtent, subresource, texture.levelSize(baseLevel + level), pixels);
+        }
+        m_uploader.releaseImage(image.image, levelCount);
+
+        // uvs are kept unwrapped by the loaders, the sampler repeats
+        const auto samplerInfo = nvvk::makeSamplerCreateInfo(VK_FILTER_LINEAR, VK_FILTER_LINEAR,
+                                                             VK_SAMPLER_ADDRESS_MODE_REPEAT, VK_SAMPLER_ADDRESS_MODE_REPEAT, VK_SAMPLER_ADDRESS_MODE_REPEAT,
+                                                             VK_FALSE, 16.f, VK_SAMPLER_MIPMAP_MODE_LINEAR, 0.f, static_cast<float>(levelCount));
+        return m_allocatorHandle.createTexture(image, nvvk::makeImageViewCreateInfo(image.image, imageInfo), samplerInfo);
+    }
+
     VkDevice m_deviceHandle{};
     nvvk::ResourceAllocatorVma m_allocatorHandle{};
     uint32_t m_transferQueueFamilyIndex{~0U};
     VkQueue m_transferQueue{};
+    // blocking copies of the rare heap reallocations
+    uint32_t m_graphicsQueueFamilyIndex{~0U};
+    VkQueue m_graphicsQueue{};
+    // textures & geometry are uploaded on the transfer queue, frames wait for its timeline semaphore
+    TransferUploader m_uploader{};
 
     std::vector<objectGroup> m_objects{};
     std::vector<Texture> m_textures{};
     std::vector<Material> m_materials{};
 
-    // merge all vertices and indices into few large buffers
-    // and use offset to draw different objects
-    // and use lazy update to merge objects' draw data
-    nvvk::Buffer m_vertexBuffer{};
-    nvvk::Buffer m_triangleBuffer{};
-    nvvk::Buffer m_materialBuffer{};
-    nvvk::Buffer m_indexBuffer{};
-    size_t m_totalVertexCount{};
+    // all objects share few large buffers, sub-allocated per mesh so adding or removing one only touches its own ranges
+    // vertices are VertexAttribute, or QuantizedVertex when every mesh has them and their bounds stay addressable by 16 bits
+    GeometryHeap m_vertexHeap{};
+    // faces & indices of all levels of a mesh, one element per triangle: stream 0 is FaceAttribute, stream 1 three indices
+    GeometryHeap m_triangleHeap{};
+    // one VertexBounds per mesh, used by QuantizedVertex
+    GeometryHeap m_boundsHeap{};
+    // one MeshAttribute per mesh, read by the culling pass
+    GeometryHeap m_meshHeap{};
+    GeometryHeap m_meshletHeap{};
+    // append only, faces refer to materials by their position in m_materials
+    GeometryHeap m_materialHeap{};
+    uint32_t m_uploadedMaterialCount{0U};
+    bool m_quantizedVertices{false};
+    bool m_geometryBound{false};
+    std::vector<sMeshDraw> m_meshDraws{};
+    // instances are rebuilt into rows when they or the meshes change, a row's index is its draws' firstInstance
+    static constexpr uint32_t initialInstanceCapacity = 256U;
+    std::vector<sInstance> m_instances{};
+    std::vector<InstanceAttribute> m_instanceRows{};
+    nvvk::Buffer m_instanceBuffer{};
+    // moved instances whose rows wait for the next cmdUpdateInstances
+    std::vector<uint32_t> m_dirtyInstances{};
+    std::vector<sInstanceStaging> m_instanceStagings{};
+    // the culling passes compact the rows' DrawCommands into m_drawBuffer, counting them in m_drawCountBuffer
+    // m_instanceVisibilityBuffer flags the rows found visible by the last frame, the first phase draws them again
+    nvvk::Buffer m_drawBuffer{};
+    nvvk::Buffer m_drawCountBuffer{};
+    nvvk::Buffer m_instanceVisibilityBuffer{};
+    bool m_instanceVisibilityNeedsClear{false};
+    uint32_t m_drawCapacity{0U};
+    uint32_t m_maxDrawCount{0U};
+    // rows drawn at level 0 are expanded to their meshlets: the instance pass queues them as jobs for the meshlet pass,
+    // which flags each meshlet in m_meshletVisibilityBuffer like the rows
+    nvvk::Buffer m_clusterJobBuffer{};
+    nvvk::Buffer m_meshletVisibilityBuffer{};
+    uint32_t m_meshletVisibilityCapacity{0U};
+    bool m_meshletVisibilityNeedsClear{false};
+    std::vector<nvvk::Buffer> m_drawCountReadbacks{};
+    std::vector<bool> m_drawCountsResolved{};
+    bool m_drawCountsCulled{false};
+    // draws of the current phase, drawn/culled/occluded instances, the meshlet pass' dispatch, drawn/culled/occluded meshlets
+    uint32_t m_drawCounts[12]{};
+    uint32_t m_instanceCapacity{0U};
+    bool m_instancesDirty{false};
+    bool m_instanceTableDirty{false};
+    std::vector<sMeshRef> m_unuploadedMeshes{};
     bool m_dirty{false};
+    bool m_texturesDirty{false};
+
+    // filled by loader threads, drained on the render thread
+    std::mutex m_pendingMutex{};
+    std::vector<sPendingMaterials> m_pendingMaterials{};
+    std::vector<sPendingMesh> m_pendingMeshes{};
+    std::vector<sPendingTexture> m_pendingTextures{};
+    std::unordered_map<uint32_t, sStreamingBase> m_streamingBases{};
 
     // for convience, directly hold descriptors
     VkDescriptorPool m_descPool{};
@@ -233,8 +1218,31 @@ protected:
     VkDescriptorSet m_geometrySet{};
     nvvk::DescriptorSetBindings m_textureBinding{};
     VkDescriptorSetLayout m_textureSetLayout{};
+    // set by the application from the device's update after bind limits & its swapchain
+    uint32_t m_textureSetLimit{initialTextureSetCapacity};
+    uint32_t m_textureSetFrameCount{1U};
+    VkDescriptorPool m_texturePool{};
+    std::vector<VkDescriptorSet> m_textureSets{};
+    uint32_t m_textureSetCapacity{0U};
+    // slots changed since each set was last written, and how many slots have been handed to the sets so far
+    std::vector<std::vector<uint32_t>> m_textureSetDirtySlots{};
+    uint32_t m_reservedTextureCount{0U};
+    std::vector<sRetiredTexturePool> m_retiredTexturePools{};
+    // the set of the frame being recorded
     VkDescriptorSet m_textureSet{};
 
+    // texture streaming: the shading pass accumulates per texture requests in the feedback buffer,
+    // copied to the frame's readback at its end and read by the CPU when that frame comes round again
+    static constexpr uint64_t streamingUploadLimit = 64ULL << 20;
+    uint64_t m_textureBudget{1ULL << 30}; // GPU bytes of texture levels, set by the application
+    TextureStreamer m_textureStreamer{};
+    nvvk::Buffer m_feedbackBuffer{};
+    std::vector<nvvk::Buffer> m_feedbackReadbacks{};
+    std::vector<uint32_t> m_feedbackCounts{};
+    bool m_feedbackNeedsClear{false};
+    std::vector<sRetiredTexture> m_retiredTextures{};
+    nvvk::Texture m_defaultTexture{};
+
     /* texture maps */
     /* basic */
     // nvvk::Texture diffuseMap{};  // RGB->diffuse, A->alpha(need rearrange)
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <string>
 
 #include <nvvk/resourceallocator_vk.hpp>
@@ -11,7 +12,23 @@ struct Texture
     int32_t width{};
     int32_t height{};
     VkFormat format{};
+    uint32_t mipLevels{1U};
 
-    void* cpuHandle{nullptr};
+    void* cpuHandle{nullptr}; // malloc-ed pixels (stb_image's own buffer), released by free(); holds all mip levels one after another
     nvvk::Texture gpuHandle{};
+
+    // bytes of a mip level in cpuHandle, block compressed formats (BC7 from the KTX2 cache) store 4x4 blocks
+    size_t levelSize(uint32_t level) const
+    {
+        const auto levelWidth = std::max(static_cast<uint32_t>(width) >> level, 1U);
+        const auto levelHeight = std::max(static_cast<uint32_t>(height) >> level, 1U);
+        switch (format)
+        {
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+        case VK_FORMAT_BC7_SRGB_BLOCK:
+            return static_cast<size_t>((levelWidth + 3) / 4) * ((levelHeight + 3) / 4) * 16;
+        default:
+            return static_cast<size_t>(levelWidth) * levelHeight * 4;
+        }
+    }
 };
\ No newline at end of file
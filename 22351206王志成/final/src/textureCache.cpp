@@ -0,0 +1,180 @@
+#include <cstring>
+#include <mutex>
+
+#include <fileformats/nv_ktx.h>
+
+#include "modelLoader.h"
+
+// one KTX2 file per texture: UASTC, zstd supercompressed, with the full mip chain
+// the file name is the hash of the key, the key itself is stored in the key/value data and compared on load
+namespace
+{
+    constexpr uint32_t textureCacheVersion = 2U;
+    constexpr const char *cacheKeyName = "GFCacheKey";
+    // higher levels hardly shrink the files further but take much longer to encode
+    constexpr int zstdLevel = 10;
+
+    uint64_t fnv1a(const void *data, size_t size, uint64_t hash = 0xcbf29ce484222325ULL)
+    {
+        for (auto i = 0ULL; i < size; ++i)
+        {
+            hash ^= static_cast<const uint8_t *>(data)[i];
+            hash *= 0x100000001b3ULL;
+        }
+        return hash;
+    }
+
+    std::string describeFile(const std::filesystem::path &path)
+    {
+        std::error_code error;
+        auto res = std::filesystem::absolute(path, error).generic_string();
+        res += "|" + std::to_string(std::filesystem::last_write_time(path, error).time_since_epoch().count());
+        res += "|" + std::to_string(std::filesystem::file_size(path, error));
+        return res;
+    }
+
+    std::filesystem::path makeTexturePath(const std::string &key, const LoaderOptions &options)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.ktx2", static_cast<unsigned long long>(fnv1a(key.data(), key.size())));
+        return options.cacheDirectory / "textures" / name;
+    }
+}
+
+// embedded images have no file to describe, their content is hashed instead
+std::string ModelLoader::makeTextureCacheKey(const sTextureRef &ref, const std::filesystem::path &texPath)
+{
+    auto key = std::to_string(textureCacheVersion) + "|" + std::to_string(ref.srgb) + "|" + std::to_string(ref.bumpScale) + "|" +
+               std::to_string(ref.keepMask) + "|" + std::to_string(ref.fillTexel);
+    if (ref.packed)
+    {
+        for (const auto &channelName : ref.channelNames)
+            key += "|" + (channelName.empty() ? std::string("-") : describeFile(texPath / channelName));
+    }
+    else if (ref.encoded)
+    {
+        char hash[20];
+        snprintf(hash, sizeof(hash), "%016llx", static_cast<unsigned long long>(fnv1a(ref.encoded, ref.encodedSize)));
+        key += "|" + ref.name + "|" + std::to_string(ref.encodedSize) + "|" + hash;
+    }
+    else
+        key += "|" + describeFile(texPath / ref.name);
+    if (!ref.alphaName.empty())
+        key += "|" + describeFile(texPath / ref.alphaName);
+    return key;
+}
+
+bool ModelLoader::loadTextureCache(const sTextureRef &ref, const std::filesystem::path &texPath, const LoaderOptions &options, Texture &texture)
+{
+    const auto key = makeTextureCacheKey(ref, texPath);
+    const auto cachePath = makeTexturePath(key, options);
+    if (!std::filesystem::exists(cachePath))
+        return false;
+
+    // UASTC is transcoded to BC7 while reading
+    nv_ktx::KTXImage image{};
+    if (const auto error = image.readFromFile(cachePath.generic_string().c_str(), nv_ktx::ReadSettings{}))
+    {
+        printf("WARNING: failed to read texture cache [%s]: %s.\n", cachePath.generic_string().c_str(), error->c_str());
+        return false;
+    }
+    const auto storedKey = image.key_value_data.find(cacheKeyName);
+    if (storedKey == image.key_value_data.end() || std::string(storedKey->second.begin(), storedKey->second.end()) != key)
+    {
+        printf("WARNING: texture cache [%s] is outdated, reloading texture [%s].\n", cachePath.generic_string().c_str(), ref.name.c_str());
+        return false;
+    }
+    if (image.format != VK_FORMAT_BC7_UNORM_BLOCK && image.format != VK_FORMAT_BC7_SRGB_BLOCK)
+    {
+        printf("WARNING: texture cache [%s] was transcoded to unexpected format %d.\n", cachePath.generic_string().c_str(), image.format);
+        return false;
+    }
+
+    Texture res{};
+    res.name = ref.name;
+    res.width = static_cast<int32_t>(image.mip_0_width);
+    res.height = static_cast<int32_t>(image.mip_0_height);
+    // sRGB data is sampled as stored, same as the uncompressed RGBA8 textures
+    res.format = VK_FORMAT_BC7_UNORM_BLOCK;
+    res.mipLevels = std::max(image.num_mips, 1U);
+    auto size = 0ULL;
+    for (auto level = 0U; level < res.mipLevels; ++level)
+    {
+        if (image.subresource(level).size() != res.levelSize(level))
+        {
+            printf("WARNING: texture cache [%s] has a mip level of unexpected size.\n", cachePath.generic_string().c_str());
+            return false;
+        }
+        size += res.levelSize(level);
+    }
+    res.cpuHandle = malloc(size);
+    if (res.cpuHandle == nullptr)
+        return false;
+    auto *dst = static_cast<char *>(res.cpuHandle);
+    for (auto level = 0U; level < res.mipLevels; ++level)
+    {
+        memcpy(dst, image.subresource(level).data(), res.levelSize(level));
+        dst += res.levelSize(level);
+    }
+    texture = res;
+    return true;
+}
+
+bool ModelLoader::saveTextureCache(const sTextureRef &ref, const std::filesystem::path &texPath, const LoaderOptions &options, const Texture &texture)
+{
+#if !defined(NVP_SUPPORTS_BASISU) || !defined(NVP_SUPPORTS_ZSTD)
+    static std::once_flag warned;
+    std::call_once(warned, []()
+                   { printf("WARNING: texture compression needs basis_universal and zstd, textures stay uncompressed.\n"); });
+    return false;
+#else
+    if (texture.format != VK_FORMAT_R8G8B8A8_UNORM)
+        return false;
+    const auto key = makeTextureCacheKey(ref, texPath);
+    const auto cachePath = makeTexturePath(key, options);
+
+    // basis_universal takes BGRA input, perceptual metrics are used for color textures
+    nv_ktx::KTXImage image{};
+    image.mip_0_width = static_cast<uint32_t>(texture.width);
+    image.mip_0_height = static_cast<uint32_t>(texture.height);
+    image.mip_0_depth = 0U;
+    image.format = ref.srgb ? VK_FORMAT_B8G8R8A8_SRGB : VK_FORMAT_B8G8R8A8_UNORM;
+    image.is_srgb = ref.srgb;
+    if (const auto error = image.allocate(texture.mipLevels, 0U, 1U))
+    {
+        printf("WARNING: failed to compress texture [%s]: %s.\n", ref.name.c_str(), error->c_str());
+        return false;
+    }
+    const auto *src = static_cast<const uint8_t *>(texture.cpuHandle);
+    for (auto level = 0U; level < texture.mipLevels; ++level)
+    {
+        auto &subresource = image.subresource(level);
+        subresource.resize(texture.levelSize(level));
+        for (auto i = 0ULL; i < subresource.size(); i += 4)
+        {
+            subresource[i + 0] = static_cast<char>(src[i + 2]);
+            subresource[i + 1] = static_cast<char>(src[i + 1]);
+            subresource[i + 2] = static_cast<char>(src[i + 0]);
+            subresource[i + 3] = static_cast<char>(src[i + 3]);
+        }
+        src += subresource.size();
+    }
+    image.key_value_data[cacheKeyName] = std::vector<char>(key.begin(), key.end());
+
+    nv_ktx::WriteSettings settings{};
+    settings.encode_rgba8_to_format = nv_ktx::EncodeRGBA8ToFormat::UASTC;
+    settings.uastc_encoding_quality = nv_ktx::UASTCEncodingQuality::FASTER;
+    settings.supercompression = nv_ktx::WriteSupercompressionType::ZSTD;
+    settings.supercompression_level = zstdLevel;
+
+    std::error_code fsError;
+    std::filesystem::create_directories(cachePath.parent_path(), fsError);
+    if (const auto error = image.writeKTX2File(cachePath.generic_string().c_str(), settings))
+    {
+        printf("WARNING: failed to write texture cache [%s]: %s.\n", cachePath.generic_string().c_str(), error->c_str());
+        std::filesystem::remove(cachePath, fsError);
+        return false;
+    }
+    return true;
+#endif
+}
\ No newline at end of file
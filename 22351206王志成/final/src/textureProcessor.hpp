@@ -0,0 +1,73 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+/* load time texture conversions on decoded RGBA8 pixels, run by the thread decoding the texture */
+// loops work on whole 32 bit texels with shifts & masks instead of strided bytes, which compilers turn into vector code
+namespace TextureProcessor
+{
+    namespace detail
+    {
+        inline uint32_t loadTexel(const uint8_t *rgba, size_t index)
+        {
+            uint32_t texel;
+            memcpy(&texel, rgba + 4 * index, sizeof(texel));
+            return texel;
+        }
+
+        inline void storeTexel(uint8_t *rgba, size_t index, uint32_t texel)
+        {
+            memcpy(rgba + 4 * index, &texel, sizeof(texel));
+        }
+    }
+
+    // channel 0..3 of every texel is replaced by the matching value of a single channel image
+    inline void insertChannel(uint8_t *rgba, const uint8_t *values, size_t texelCount, uint32_t channel)
+    {
+        const auto shift = 8 * channel;
+        const auto mask = ~(0xFFU << shift);
+        for (auto i = 0ULL; i < texelCount; ++i)
+            detail::storeTexel(rgba, i, (detail::loadTexel(rgba, i) & mask) | (static_cast<uint32_t>(values[i]) << shift));
+    }
+
+    inline void fillTexels(uint8_t *rgba, uint32_t texel, size_t texelCount)
+    {
+        for (auto i = 0ULL; i < texelCount; ++i)
+            detail::storeTexel(rgba, i, texel);
+    }
+
+    // the channels outside keepMask are replaced by those of texel
+    inline void maskTexels(uint8_t *rgba, uint32_t keepMask, uint32_t texel, size_t texelCount)
+    {
+        for (auto i = 0ULL; i < texelCount; ++i)
+            detail::storeTexel(rgba, i, (detail::loadTexel(rgba, i) & keepMask) | (texel & ~keepMask));
+    }
+
+    // tangent space normals from a height map by central differences, wrapping around as the sampler repeats
+    // rows are stored bottom up (textures are decoded flipped), so +y is +v like the OpenGL normal map convention
+    // scale is the height of a full range bump in texels, alpha is set to 0xFF
+    inline void bumpToNormal(const uint8_t *heights, uint32_t width, uint32_t height, float scale, uint8_t *rgba)
+    {
+        const auto factor = scale * .5f / 255.f;
+        for (auto y = 0U; y < height; ++y)
+        {
+            const auto *row = heights + static_cast<size_t>(y) * width;
+            const auto *below = heights + static_cast<size_t>(y == 0 ? height - 1 : y - 1) * width;
+            const auto *above = heights + static_cast<size_t>(y + 1 == height ? 0 : y + 1) * width;
+            for (auto x = 0U; x < width; ++x)
+            {
+                const auto left = row[x == 0 ? width - 1 : x - 1], right = row[x + 1 == width ? 0 : x + 1];
+                const auto dx = (static_cast<float>(left) - right) * factor;
+                const auto dy = (static_cast<float>(below[x]) - above[x]) * factor;
+                const auto invLength = 1.f / std::sqrt(dx * dx + dy * dy + 1.f);
+                auto encode = [](float v)
+                { return static_cast<uint32_t>(std::clamp(v * 127.5f + 127.5f, 0.f, 255.f) + .5f); };
+                detail::storeTexel(rgba, static_cast<size_t>(y) * width + x,
+                                   encode(dx * invLength) | encode(dy * invLength) << 8 | encode(invLength) << 16 | 0xFF000000U);
+            }
+        }
+    }
+}
\ No newline at end of file
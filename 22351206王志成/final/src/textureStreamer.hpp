@@ -0,0 +1,162 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <vector>
+
+/* decides which mip levels of every texture are resident on the GPU, from the shading pass' feedback */
+// whole chains stay in system memory, a texture's GPU image only holds its levels [baseLevel, levelCount):
+// levels requested by the feedback are uploaded finest first, least recently used levels are dropped to stay within the budget
+class TextureStreamer
+{
+public:
+    // levels whose larger side is at most this many texels are always resident
+    static constexpr uint32_t kTailSize = 64U;
+    // textures not requested for this many frames fall back to their tail
+    static constexpr uint64_t kIdleFrames = 120ULL;
+
+    struct sChange
+    {
+        uint32_t slot{};
+        uint32_t baseLevel{};
+    };
+
+    // levelSizes holds the bytes of every level, returns the base level to upload first
+    uint32_t addTexture(uint32_t slot, uint32_t width, uint32_t height, const std::vector<size_t> &levelSizes)
+    {
+        if (slot >= m_slots.size())
+            m_slots.resize(slot + 1);
+        auto &texture = m_slots[slot];
+        m_residentBytes -= texture.residentBytes();
+
+        texture.finestLog2 = static_cast<uint32_t>(std::bit_width(std::max({width, height, 1U}))) - 1;
+        texture.levelCount = static_cast<uint32_t>(levelSizes.size());
+        texture.suffixSizes.assign(texture.levelCount + 1, 0ULL);
+        for (auto level = texture.levelCount; level-- > 0;)
+            texture.suffixSizes[level] = texture.suffixSizes[level + 1] + levelSizes[level];
+        texture.tailLevel = texture.finestLog2 > std::bit_width(kTailSize) - 1 ? texture.finestLog2 - (std::bit_width(kTailSize) - 1) : 0U;
+        texture.tailLevel = std::min(texture.tailLevel, texture.levelCount - 1);
+        texture.baseLevel = texture.requestedLevel = texture.tailLevel;
+        texture.lastUsed = 0ULL;
+
+        m_residentBytes += texture.residentBytes();
+        return texture.baseLevel;
+    }
+
+    // feedback[slot] is 0 for textures the shading pass did not sample, otherwise 1 + log2 of the texels per uv unit it needed
+    void readFeedback(const uint32_t *feedback, size_t count)
+    {
+        ++m_frame;
+        count = std::min(count, m_slots.size());
+        for (auto slot = 0ULL; slot < count; ++slot)
+        {
+            auto &texture = m_slots[slot];
+            if (feedback[slot] == 0U || texture.levelCount == 0U)
+                continue;
+            const auto neededLog2 = feedback[slot] - 1;
+            texture.requestedLevel = std::min(texture.finestLog2 > neededLog2 ? texture.finestLog2 - neededLog2 : 0U, texture.tailLevel);
+            texture.lastUsed = m_frame;
+        }
+    }
+
+    // appends the base level changes to apply, uploads are limited to uploadLimit bytes per call (but always let one through)
+    void update(uint64_t budget, uint64_t uploadLimit, std::vector<sChange> &changes)
+    {
+        changes.clear();
+        std::vector<uint32_t> candidates{};
+        for (auto slot = 0U; slot < m_slots.size(); ++slot)
+            if (m_slots[slot].levelCount > 0U && wantedLevel(m_slots[slot]) < m_slots[slot].baseLevel)
+                candidates.push_back(slot);
+        if (candidates.empty())
+            return;
+        // textures missing the most levels first, recently used ones first among them
+        std::sort(candidates.begin(), candidates.end(), [&](uint32_t a, uint32_t b)
+                  {
+                      const auto missingA = m_slots[a].baseLevel - wantedLevel(m_slots[a]), missingB = m_slots[b].baseLevel - wantedLevel(m_slots[b]);
+                      return missingA != missingB ? missingA > missingB : m_slots[a].lastUsed > m_slots[b].lastUsed; });
+
+        std::vector<bool> touched(m_slots.size(), false);
+        auto uploaded = 0ULL;
+        for (const auto slot : candidates)
+        {
+            auto &texture = m_slots[slot];
+            if (touched[slot])
+                continue;
+            // the coarsest levels are tried once the budget can't hold the finest ones
+            for (auto level = wantedLevel(texture); level < texture.baseLevel; ++level)
+            {
+                const auto cost = texture.suffixSizes[level] - texture.suffixSizes[texture.baseLevel];
+                if (m_residentBytes + cost > budget)
+                    evict(slot, m_residentBytes + cost - budget, touched, changes);
+                if (m_residentBytes + cost > budget)
+                    continue;
+                if (uploaded > 0ULL && uploaded + texture.suffixSizes[level] > uploadLimit)
+                    return;
+                uploaded += texture.suffixSizes[level];
+                m_residentBytes += cost;
+                texture.baseLevel = level;
+                touched[slot] = true;
+                changes.push_back({slot, level});
+                break;
+            }
+        }
+    }
+
+    uint64_t residentBytes() const { return m_residentBytes; }
+
+private:
+    struct sTexture
+    {
+        uint32_t finestLog2{};
+        uint32_t levelCount{0U};
+        uint32_t tailLevel{};
+        uint32_t baseLevel{};
+        uint32_t requestedLevel{};
+        uint64_t lastUsed{};
+        std::vector<size_t> suffixSizes{}; // bytes of levels [level, levelCount)
+
+        uint64_t residentBytes() const { return levelCount > 0U ? suffixSizes[baseLevel] : 0ULL; }
+    };
+
+    uint32_t wantedLevel(const sTexture &texture) const
+    {
+        return m_frame - texture.lastUsed > kIdleFrames ? texture.tailLevel : texture.requestedLevel;
+    }
+
+    // frees at least bytes from other textures: levels no longer wanted first, then whole textures not sampled in the last feedback,
+    // least recently used first, down to their tail
+    void evict(uint32_t requester, uint64_t bytes, std::vector<bool> &touched, std::vector<sChange> &changes)
+    {
+        std::vector<uint32_t> victims{};
+        for (auto slot = 0U; slot < m_slots.size(); ++slot)
+        {
+            const auto &texture = m_slots[slot];
+            if (slot != requester && !touched[slot] && texture.levelCount > 0U && texture.baseLevel < texture.tailLevel &&
+                (texture.baseLevel < wantedLevel(texture) || texture.lastUsed < m_frame))
+                victims.push_back(slot);
+        }
+        std::sort(victims.begin(), victims.end(), [&](uint32_t a, uint32_t b)
+                  {
+                      const auto surplusA = m_slots[a].baseLevel < wantedLevel(m_slots[a]), surplusB = m_slots[b].baseLevel < wantedLevel(m_slots[b]);
+                      return surplusA != surplusB ? surplusA : m_slots[a].lastUsed < m_slots[b].lastUsed; });
+
+        auto freed = 0ULL;
+        for (const auto slot : victims)
+        {
+            if (freed >= bytes)
+                break;
+            auto &texture = m_slots[slot];
+            const auto level = texture.lastUsed < m_frame ? texture.tailLevel : wantedLevel(texture);
+            freed += texture.suffixSizes[texture.baseLevel] - texture.suffixSizes[level];
+            m_residentBytes -= texture.suffixSizes[texture.baseLevel] - texture.suffixSizes[level];
+            texture.baseLevel = level;
+            touched[slot] = true;
+            changes.push_back({slot, level});
+        }
+    }
+
+    std::vector<sTexture> m_slots{};
+    uint64_t m_residentBytes{0ULL};
+    uint64_t m_frame{0ULL};
+};
\ No newline at end of file
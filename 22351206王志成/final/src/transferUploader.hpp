@@ -0,0 +1,214 @@
+#pragma once
+
+#include <vector>
+
+#include <nvvk/error_vk.hpp>
+#include <nvvk/stagingmemorymanager_vk.hpp>
+#include <nvvk/structs_vk.hpp>
+
+/* uploads recorded on the transfer queue and submitted without waiting, the graphics queue waits on a timeline semaphore instead */
+// resources written by a batch are released to the graphics queue family at its end, the matching acquire barriers
+// are recorded at the start of the next frame, whose submission waits for the batch's timeline value;
+// staging memory & command buffers of a batch are recycled once the semaphore has passed its value
+class TransferUploader
+{
+public:
+    void init(VkDevice device, nvvk::StagingMemoryManager *staging, uint32_t transferFamily, VkQueue transferQueue, uint32_t graphicsFamily)
+    {
+        m_device = device;
+        m_staging = staging;
+        m_transferFamily = transferFamily;
+        m_transferQueue = transferQueue;
+        m_graphicsFamily = graphicsFamily;
+
+        VkCommandPoolCreateInfo poolInfo = nvvk::make<VkCommandPoolCreateInfo>();
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        poolInfo.queueFamilyIndex = transferFamily;
+        NVVK_CHECK(vkCreateCommandPool(m_device, &poolInfo, nullptr, &m_commandPool));
+
+        VkSemaphoreTypeCreateInfo typeInfo = nvvk::make<VkSemaphoreTypeCreateInfo>();
+        typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+        typeInfo.initialValue = 0ULL;
+        VkSemaphoreCreateInfo semaphoreInfo = nvvk::make<VkSemaphoreCreateInfo>();
+        semaphoreInfo.pNext = &typeInfo;
+        NVVK_CHECK(vkCreateSemaphore(m_device, &semaphoreInfo, nullptr, &m_semaphore));
+    }
+
+    // the device has to be idle
+    void deinit()
+    {
+        if (m_device == VK_NULL_HANDLE)
+            return;
+        for (const auto &batch : m_pending)
+            m_staging->releaseResourceSet(batch.staging);
+        m_pending.clear();
+        m_freeCommandBuffers.clear();
+        vkDestroyCommandPool(m_device, m_commandPool, nullptr);
+        vkDestroySemaphore(m_device, m_semaphore, nullptr);
+        m_device = VK_NULL_HANDLE;
+    }
+
+    // command buffer of the batch being recorded
+    VkCommandBuffer getCommandBuffer()
+    {
+        if (m_recording != VK_NULL_HANDLE)
+            return m_recording;
+        if (m_freeCommandBuffers.empty())
+        {
+            VkCommandBufferAllocateInfo allocInfo = nvvk::make<VkCommandBufferAllocateInfo>();
+            allocInfo.commandPool = m_commandPool;
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            allocInfo.commandBufferCount = 1;
+            NVVK_CHECK(vkAllocateCommandBuffers(m_device, &allocInfo, &m_recording));
+        }
+        else
+        {
+            m_recording = m_freeCommandBuffers.back();
+            m_freeCommandBuffers.pop_back();
+        }
+        VkCommandBufferBeginInfo beginInfo = nvvk::make<VkCommandBufferBeginInfo>();
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        NVVK_CHECK(vkBeginCommandBuffer(m_recording, &beginInfo));
+        return m_recording;
+    }
+
+    // the range was written by transfer commands of this batch, the graphics queue reads it from vertex input on
+    void releaseBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size)
+    {
+        if (m_transferFamily == m_graphicsFamily)
+            return;
+        VkBufferMemoryBarrier barrier = nvvk::make<VkBufferMemoryBarrier>();
+        barrier.srcQueueFamilyIndex = m_transferFamily;
+        barrier.dstQueueFamilyIndex = m_graphicsFamily;
+        barrier.buffer = buffer;
+        barrier.offset = offset;
+        barrier.size = size;
+        m_bufferReleases.push_back(barrier);
+    }
+
+    // all levels were written in TRANSFER_DST_OPTIMAL, the graphics queue samples them in SHADER_READ_ONLY_OPTIMAL
+    void releaseImage(VkImage image, uint32_t levelCount)
+    {
+        VkImageMemoryBarrier barrier = nvvk::make<VkImageMemoryBarrier>();
+        const auto transferOwnership = m_transferFamily != m_graphicsFamily;
+        barrier.srcQueueFamilyIndex = transferOwnership ? m_transferFamily : VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = transferOwnership ? m_graphicsFamily : VK_QUEUE_FAMILY_IGNORED;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.image = image;
+        barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0U, levelCount, 0U, 1U};
+        m_imageReleases.push_back(barrier);
+    }
+
+    // nothing to do when no command was requested since the last submit
+    void submit()
+    {
+        if (m_recording == VK_NULL_HANDLE)
+            return;
+
+        // with a single family the layout transition is all that's left, the semaphore orders the memory accesses
+        for (auto &barrier : m_bufferReleases)
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        for (auto &barrier : m_imageReleases)
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        if (!m_bufferReleases.empty() || !m_imageReleases.empty())
+            vkCmdPipelineBarrier(m_recording, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr,
+                                 static_cast<uint32_t>(m_bufferReleases.size()), m_bufferReleases.data(),
+                                 static_cast<uint32_t>(m_imageReleases.size()), m_imageReleases.data());
+        NVVK_CHECK(vkEndCommandBuffer(m_recording));
+
+        // the graphics side repeats the ownership transfers as acquires
+        if (m_transferFamily != m_graphicsFamily)
+        {
+            for (auto barrier : m_bufferReleases)
+            {
+                barrier.srcAccessMask = 0;
+                barrier.dstAccessMask = VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+                m_bufferAcquires.push_back(barrier);
+            }
+            for (auto barrier : m_imageReleases)
+            {
+                barrier.srcAccessMask = 0;
+                barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+                m_imageAcquires.push_back(barrier);
+            }
+        }
+        m_bufferReleases.clear();
+        m_imageReleases.clear();
+
+        sBatch batch{m_recording, ++m_submittedValue, m_staging->finalizeResourceSet()};
+        VkTimelineSemaphoreSubmitInfo timelineInfo = nvvk::make<VkTimelineSemaphoreSubmitInfo>();
+        timelineInfo.signalSemaphoreValueCount = 1;
+        timelineInfo.pSignalSemaphoreValues = &batch.value;
+        VkSubmitInfo submitInfo = nvvk::make<VkSubmitInfo>();
+        submitInfo.pNext = &timelineInfo;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &batch.cmdBuf;
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores = &m_semaphore;
+        NVVK_CHECK(vkQueueSubmit(m_transferQueue, 1, &submitInfo, VK_NULL_HANDLE));
+        m_pending.push_back(batch);
+        m_recording = VK_NULL_HANDLE;
+    }
+
+    // records the acquires of every batch submitted so far, the frame's submission then has to wait for getWaitValue()
+    void cmdAcquire(VkCommandBuffer cmdBuf)
+    {
+        m_waitValue = m_submittedValue;
+        if (m_bufferAcquires.empty() && m_imageAcquires.empty())
+            return;
+        vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                             VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             0, 0, nullptr, static_cast<uint32_t>(m_bufferAcquires.size()), m_bufferAcquires.data(),
+                             static_cast<uint32_t>(m_imageAcquires.size()), m_imageAcquires.data());
+        m_bufferAcquires.clear();
+        m_imageAcquires.clear();
+    }
+
+    // recycles the batches the transfer queue has finished
+    void collect()
+    {
+        if (m_pending.empty())
+            return;
+        uint64_t completed{};
+        NVVK_CHECK(vkGetSemaphoreCounterValue(m_device, m_semaphore, &completed));
+        std::erase_if(m_pending, [&](const sBatch &batch)
+                      {
+                          if (batch.value > completed)
+                              return false;
+                          m_staging->releaseResourceSet(batch.staging);
+                          vkResetCommandBuffer(batch.cmdBuf, 0);
+                          m_freeCommandBuffers.push_back(batch.cmdBuf);
+                          return true; });
+    }
+
+    VkSemaphore getSemaphore() const { return m_semaphore; }
+    uint64_t getWaitValue() const { return m_waitValue; }
+
+private:
+    struct sBatch
+    {
+        VkCommandBuffer cmdBuf{};
+        uint64_t value{};
+        nvvk::StagingMemoryManager::SetID staging{};
+    };
+
+    VkDevice m_device{VK_NULL_HANDLE};
+    nvvk::StagingMemoryManager *m_staging{nullptr};
+    uint32_t m_transferFamily{~0U};
+    VkQueue m_transferQueue{};
+    uint32_t m_graphicsFamily{~0U};
+
+    VkCommandPool m_commandPool{};
+    VkSemaphore m_semaphore{};
+    uint64_t m_submittedValue{0ULL};
+    uint64_t m_waitValue{0ULL};
+
+    VkCommandBuffer m_recording{VK_NULL_HANDLE};
+    std::vector<VkBufferMemoryBarrier> m_bufferReleases{};
+    std::vector<VkImageMemoryBarrier> m_imageReleases{};
+    std::vector<VkBufferMemoryBarrier> m_bufferAcquires{};
+    std::vector<VkImageMemoryBarrier> m_imageAcquires{};
+    std::vector<sBatch> m_pending{};
+    std::vector<VkCommandBuffer> m_freeCommandBuffers{};
+};
\ No newline at end of file
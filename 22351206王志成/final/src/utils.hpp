@@ -17,6 +17,7 @@ namespace std
         {
             size_t seed = 0ULL;
             hash_combine(seed, hash<float>()(obj.x));
+            hash_combine(seed, hash<float>()(obj.y));
             return seed;
         }
     };
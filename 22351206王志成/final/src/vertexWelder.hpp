@@ -0,0 +1,226 @@
+#pragma once
+
+#include <bit>
+#include <vector>
+
+#include "jobSystem.hpp"
+
+#include "mesh.hpp"
+
+/* open addressing hash table to deduplicate vertices */
+// each slot packs a 32-bit hash tag with the vertex index, so probing only touches the vertex data on tag hits
+// and growing the table never needs to rehash vertices
+class VertexWelder
+{
+public:
+    VertexWelder() = default;
+    explicit VertexWelder(size_t expectedVertexCount) { reserve(expectedVertexCount); }
+
+    void reserve(size_t expectedVertexCount)
+    {
+        auto capacity = std::bit_ceil(std::max<size_t>(expectedVertexCount * 2, 16ULL));
+        if (capacity > m_slots.size())
+            rehash(capacity);
+    }
+
+    void clear()
+    {
+        std::fill(m_slots.begin(), m_slots.end(), 0ULL);
+        m_count = 0;
+    }
+
+    // returns the index of vertex in vertices, appending it when it has not been seen before
+    uint32_t weld(const VertexAttribute &vertex, std::vector<VertexAttribute> &vertices)
+    {
+        return weld(vertex, hash(vertex), vertices);
+    }
+
+    uint32_t weld(const VertexAttribute &vertex, uint64_t vertexHash, std::vector<VertexAttribute> &vertices)
+    {
+        if ((m_count + 1) * 2 > m_slots.size())
+            rehash(std::max<size_t>(m_slots.size() * 2, 16ULL));
+
+        const auto tag = makeTag(vertexHash);
+        const auto mask = m_slots.size() - 1;
+        for (auto pos = static_cast<size_t>(tag) & mask;; pos = (pos + 1) & mask)
+        {
+            const auto slot = m_slots[pos];
+            if (slot == 0ULL)
+            {
+                const auto index = static_cast<uint32_t>(vertices.size());
+                vertices.emplace_back(vertex);
+                m_slots[pos] = (static_cast<uint64_t>(tag) << 32) | (static_cast<uint64_t>(index) + 1);
+                m_count++;
+                return index;
+            }
+            if (static_cast<uint32_t>(slot >> 32) == tag)
+            {
+                const auto index = static_cast<uint32_t>(slot & 0xFFFFFFFFULL) - 1;
+                if (vertices[index] == vertex)
+                    return index;
+            }
+        }
+    }
+
+    // welds a whole corner stream, writing one index per corner
+    void weld(const VertexAttribute *corners, size_t count, std::vector<VertexAttribute> &vertices, std::vector<uint32_t> &indices)
+    {
+        reserve(vertices.size() + count / 4);
+        indices.reserve(indices.size() + count);
+        for (auto i = 0ULL; i < count; ++i)
+            indices.emplace_back(weld(corners[i], vertices));
+    }
+
+    // 64-bit hash over the 32 bytes of attribute bits, with -0.0 folded into +0.0 to stay consistent with operator==
+    static uint64_t hash(const VertexAttribute &vertex)
+    {
+        // read the attributes one by one, the alignment padding of nvmath::vec3 is left uninitialized
+        const uint32_t bits[8]{
+            std::bit_cast<uint32_t>(vertex.position.x), std::bit_cast<uint32_t>(vertex.position.y), std::bit_cast<uint32_t>(vertex.position.z),
+            std::bit_cast<uint32_t>(vertex.normal.x), std::bit_cast<uint32_t>(vertex.normal.y), std::bit_cast<uint32_t>(vertex.normal.z),
+            std::bit_cast<uint32_t>(vertex.uv.x), std::bit_cast<uint32_t>(vertex.uv.y)};
+        uint64_t h = 0x27D4EB2F165667C5ULL;
+        for (auto i = 0; i < 8; i += 2)
+        {
+            const auto lo = (bits[i] << 1) == 0U ? 0U : bits[i];
+            const auto hi = (bits[i + 1] << 1) == 0U ? 0U : bits[i + 1];
+            auto k = (static_cast<uint64_t>(hi) << 32) | lo;
+            k *= 0xC2B2AE3D27D4EB4FULL;
+            k = std::rotl(k, 31);
+            k *= 0x9E3779B185EBCA87ULL;
+            h ^= k;
+            h = std::rotl(h, 27) * 0x9E3779B185EBCA87ULL + 0x85EBCA77C2B2AE63ULL;
+        }
+        // avalanche
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDULL;
+        h ^= h >> 33;
+        h *= 0xC4CEB9FE1A85EC53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    size_t size() const { return m_count; }
+
+private:
+    static uint32_t makeTag(uint64_t vertexHash) { return static_cast<uint32_t>(vertexHash >> 32) ^ static_cast<uint32_t>(vertexHash); }
+
+    void rehash(size_t capacity)
+    {
+        std::vector<uint64_t> slots(capacity, 0ULL);
+        const auto mask = capacity - 1;
+        for (const auto slot : m_slots)
+        {
+            if (slot == 0ULL)
+                continue;
+            auto pos = static_cast<size_t>(slot >> 32) & mask;
+            while (slots[pos] != 0ULL)
+                pos = (pos + 1) & mask;
+            slots[pos] = slot;
+        }
+        m_slots.swap(slots);
+    }
+
+    std::vector<uint64_t> m_slots{};
+    size_t m_count{0ULL};
+};
+
+// welds a corner stream on multiple threads, producing exactly the same vertices & indices as a serial VertexWelder
+// corners are generated on demand by getCorner(cornerIndex) instead of being materialized
+//   1. hash all corners and partition them into buckets by hash, keeping corner order inside each bucket
+//   2. weld every bucket independently, mapping each corner to the first corner with the same attributes
+//   3. number first occurrences in corner order with a prefix sum over chunks, then resolve all indices
+template <typename CornerFunc>
+void weldParallel(size_t cornerCount, CornerFunc &&getCorner, std::vector<VertexAttribute> &vertices, std::vector<uint32_t> &indices, uint32_t numThreads)
+{
+    const auto chunkCount = static_cast<size_t>(numThreads) * 4;
+    const auto chunkSize = (cornerCount + chunkCount - 1) / chunkCount;
+    const auto bucketCount = std::bit_ceil(chunkCount);
+    const auto bucketShift = 64 - std::countr_zero(bucketCount);
+    auto forEachChunk = [&](auto &&func)
+    {
+        JobSystem::getInstance().parallelFor<1>(chunkCount, [&](uint64_t chunk)
+                                                { func(chunk, std::min(cornerCount, chunk * chunkSize), std::min(cornerCount, (chunk + 1) * chunkSize)); }, numThreads);
+    };
+
+    std::vector<uint64_t> hashes(cornerCount);
+    std::vector<size_t> bucketOffsets(chunkCount * bucketCount, 0ULL);
+    forEachChunk([&](uint64_t chunk, size_t begin, size_t end)
+                 {
+                     auto counts = &bucketOffsets[chunk * bucketCount];
+                     for (auto c = begin; c < end; ++c)
+                     {
+                         hashes[c] = VertexWelder::hash(getCorner(c));
+                         counts[bucketCount > 1 ? hashes[c] >> bucketShift : 0]++;
+                     } });
+
+    // bucket-major exclusive prefix sum, so chunks fill their part of each bucket in corner order
+    std::vector<size_t> bucketBegin(bucketCount + 1, 0ULL);
+    auto offset = 0ULL;
+    for (auto b = 0ULL; b < bucketCount; ++b)
+    {
+        bucketBegin[b] = offset;
+        for (auto chunk = 0ULL; chunk < chunkCount; ++chunk)
+        {
+            const auto count = bucketOffsets[chunk * bucketCount + b];
+            bucketOffsets[chunk * bucketCount + b] = offset;
+            offset += count;
+        }
+    }
+    bucketBegin[bucketCount] = offset;
+
+    std::vector<uint32_t> bucketCorners(cornerCount);
+    forEachChunk([&](uint64_t chunk, size_t begin, size_t end)
+                 {
+                     auto offsets = &bucketOffsets[chunk * bucketCount];
+                     for (auto c = begin; c < end; ++c)
+                         bucketCorners[offsets[bucketCount > 1 ? hashes[c] >> bucketShift : 0]++] = static_cast<uint32_t>(c);
+                 });
+
+    std::vector<uint32_t> representative(cornerCount);
+    JobSystem::getInstance().parallelFor<1>(bucketCount, [&](uint64_t b)
+                                            {
+                                                VertexWelder welder((bucketBegin[b + 1] - bucketBegin[b]) / 4);
+                                                std::vector<VertexAttribute> localVertices{};
+                                                std::vector<uint32_t> firstCorner{};
+                                                for (auto i = bucketBegin[b]; i < bucketBegin[b + 1]; ++i)
+                                                {
+                                                    const auto c = bucketCorners[i];
+                                                    const auto localIndex = welder.weld(getCorner(c), hashes[c], localVertices);
+                                                    if (localIndex == firstCorner.size())
+                                                        firstCorner.emplace_back(c);
+                                                    representative[c] = firstCorner[localIndex];
+                                                } }, numThreads);
+    hashes = {};
+    bucketCorners = {};
+
+    std::vector<size_t> chunkVertexBase(chunkCount + 1, 0ULL);
+    forEachChunk([&](uint64_t chunk, size_t begin, size_t end)
+                 {
+                     for (auto c = begin; c < end; ++c)
+                         chunkVertexBase[chunk + 1] += representative[c] == c;
+                 });
+    for (auto chunk = 0ULL; chunk < chunkCount; ++chunk)
+        chunkVertexBase[chunk + 1] += chunkVertexBase[chunk];
+
+    const auto vertexBegin = vertices.size();
+    const auto indexBegin = indices.size();
+    vertices.resize(vertexBegin + chunkVertexBase[chunkCount]);
+    indices.resize(indexBegin + cornerCount);
+    forEachChunk([&](uint64_t chunk, size_t begin, size_t end)
+                 {
+                     auto vertexIndex = vertexBegin + chunkVertexBase[chunk];
+                     for (auto c = begin; c < end; ++c)
+                         if (representative[c] == c)
+                         {
+                             vertices[vertexIndex] = getCorner(c);
+                             indices[indexBegin + c] = static_cast<uint32_t>(vertexIndex++);
+                         } });
+    // representatives always precede their duplicates, and were all numbered by the pass above
+    forEachChunk([&](uint64_t /*chunk*/, size_t begin, size_t end)
+                 {
+                     for (auto c = begin; c < end; ++c)
+                         if (representative[c] != c)
+                             indices[indexBegin + c] = indices[indexBegin + representative[c]];
+                 });
+}
\ No newline at end of file
@@ -0,0 +1,76 @@
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include "modelLoader.h"
+
+// loader checks that need no device, returns the number of failed checks
+//   loaderTest
+
+static uint32_t failures = 0U;
+
+static void check(bool condition, const char *what)
+{
+    if (!condition)
+    {
+        printf("FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+static void writeFile(const std::filesystem::path &path, const char *content)
+{
+    auto file = fopen(path.generic_string().c_str(), "w");
+    if (file == nullptr)
+        throw std::runtime_error("failed to write [" + path.generic_string() + "].");
+    fputs(content, file);
+    fclose(file);
+}
+
+// the 1x1 texel an unreadable map is replaced with, 0 when the texture is missing or larger
+static uint32_t fallbackTexel(const std::vector<Texture> &textures, uint32_t index)
+{
+    if (index >= textures.size() || textures[index].width != 1 || textures[index].height != 1 || textures[index].cpuHandle == nullptr)
+        return 0U;
+    uint32_t texel;
+    memcpy(&texel, textures[index].cpuHandle, sizeof(texel));
+    return texel;
+}
+
+// normal & bump maps that fail to load have to shade like a flat surface, not like the normal (1, 1, 1)
+static void testMissingNormalMaps(const std::filesystem::path &directory)
+{
+    writeFile(directory / "missingMaps.mtl",
+              "newmtl normalMapped\nKd 0.8 0.8 0.8\nnorm missing_normal.png\n\n"
+              "newmtl bumpMapped\nKd 0.8 0.8 0.8\nbump missing_bump.png\n");
+    writeFile(directory / "missingMaps.obj",
+              "mtllib missingMaps.mtl\n"
+              "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nvt 0 0\nvt 1 0\nvt 1 1\nvt 0 1\n"
+              "usemtl normalMapped\nf 1/1 2/2 3/3\n"
+              "usemtl bumpMapped\nf 1/1 3/3 4/4\n");
+
+    auto [meshes, materials, textures] = ModelLoader::getInstance().load(directory / "missingMaps.obj", directory, "", {.enableCache = false});
+    check(materials.size() == 2, "both materials are loaded");
+    for (const auto &material : materials)
+    {
+        const auto texel = fallbackTexel(textures, material.properties.normal_map_index);
+        check(texel == ModelLoader::flatNormalTexel, ("missing map of [" + material.name + "] falls back to a flat normal").c_str());
+    }
+    for (auto &texture : textures)
+        free(texture.cpuHandle);
+}
+
+int main()
+{
+    const auto directory = std::filesystem::temp_directory_path() / "loaderTest";
+    std::filesystem::create_directories(directory);
+
+    testMissingNormalMaps(directory);
+
+    printf("%s\n", failures == 0 ? "all loader tests passed" : "some loader tests failed");
+    return static_cast<int>(failures);
+}
\ No newline at end of file